@@ -0,0 +1,68 @@
+//
+// example of how to write the Parquet file to a user-provided stream, which
+// is flushed but left open by finish() so that the caller can carry on
+// writing to it (here, a second Parquet file and a trailer are appended)
+//
+
+// parquet-writer
+#include "parquet_writer.h"
+
+// std/stl
+#include <iostream>
+#include <string>
+
+// arrow
+#include <arrow/io/memory.h>
+
+// json
+#include "nlohmann/json.hpp"
+
+namespace pw = parquetwriter;
+
+void write_file(const std::shared_ptr<arrow::io::OutputStream>& stream,
+                const std::string& name, int n_rows) {
+    auto layout = R"(
+    {
+        "fields": [
+            {"name": "event", "type": "int32"},
+            {"name": "hits", "type": "list1d", "contains": {"type": "float"}}
+        ]
+    }
+    )"_json;
+
+    pw::Writer writer;
+    writer.set_layout(layout);
+    writer.set_dataset_name(name);
+    writer.set_output_stream(stream);
+    writer.initialize();
+
+    for (int irow = 0; irow < n_rows; irow++) {
+        writer.fill("event", irow);
+        writer.fill("hits", std::vector<float>(irow % 5, 1.5));
+        writer.end_row();
+    }
+
+    // flushes the stream, but does not close it
+    writer.finish();
+}
+
+int main(int argc, char* argv[]) {
+    std::shared_ptr<arrow::io::BufferOutputStream> stream;
+    PARQUET_ASSIGN_OR_THROW(stream, arrow::io::BufferOutputStream::Create());
+
+    write_file(stream, "first", 100);
+    int64_t first_size = stream->Tell().ValueOrDie();
+
+    // the stream is still open after finish(), so more can be written to it
+    write_file(stream, "second", 200);
+    std::string trailer = "END";
+    PARQUET_THROW_NOT_OK(stream->Write(trailer.data(), trailer.size()));
+
+    std::shared_ptr<arrow::Buffer> buffer;
+    PARQUET_ASSIGN_OR_THROW(buffer, stream->Finish());
+    std::cout << "first file: " << first_size << " bytes, second file: "
+              << buffer->size() - first_size - trailer.size()
+              << " bytes, trailer: " << trailer.size() << " bytes"
+              << std::endl;
+    return 0;
+}
@@ -33,5 +33,13 @@ std::shared_ptr<spdlog::logger> get_logger() {
 
 void set_debug() { spdlog::set_level(spdlog::level::debug); }
 
+void log_to_stderr() {
+    auto log = get_logger();
+    auto sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    sink->set_pattern("[parquet-writer] [%^%l%$] %v");
+    log->sinks().clear();
+    log->sinks().push_back(sink);
+}
+
 };  // namespace logging
 };  // namespace parquetwriter
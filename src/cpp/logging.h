@@ -21,6 +21,10 @@ std::shared_ptr<spdlog::logger> get_logger();
 
 void set_debug();
 
+// send the log messages to stderr rather than stdout (e.g. when stdout
+// carries the output data)
+void log_to_stderr();
+
 };  // namespace logging
 };  // namespace parquetwriter
 
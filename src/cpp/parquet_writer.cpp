@@ -4,25 +4,98 @@
 #include "parquet_writer_helpers.h"
 #include "parquet_writer_visitor.h"
 
+// arrow
+#include <arrow/compute/api.h>
+#include <parquet/arrow/schema.h>
+#include <parquet/encoding.h>
+
 // std/stl
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <set>
 #include <sstream>
 
+// posix
+#include <unistd.h>
+
 namespace parquetwriter {
 
+// the column holding the index of each row in the dataset, added to each
+// file of sharded output
+static const std::string ROW_INDEX_COLUMN = "__row_index";
+
+WriterStats& WriterStats::operator+=(const WriterStats& other) {
+    rows_written += other.rows_written;
+    row_groups_written += other.row_groups_written;
+    files_written += other.files_written;
+    bytes_written += other.bytes_written;
+    n_writes += other.n_writes;
+    n_flushes += other.n_flushes;
+    n_fsyncs += other.n_fsyncs;
+    fsync_seconds += other.fsync_seconds;
+    sort_seconds += other.sort_seconds;
+    sort_peak_bytes = std::max(sort_peak_bytes, other.sort_peak_bytes);
+    n_bloom_filters += other.n_bloom_filters;
+    bloom_filter_bytes += other.bloom_filter_bytes;
+    column_compression.insert(other.column_compression.begin(),
+                              other.column_compression.end());
+    return *this;
+}
+
 Writer::Writer()
     : _output_directory("./"),
       _dataset_name(""),
-      _file_count(0),
+      _output_sink(OutputSink::FILES),
+      _close_user_stream(false),
+      _max_open_partitions(64),
+      _drop_partition_columns(false),
+      _n_shards(1),
       _n_rows_in_group(-1),
       _n_current_rows_filled(0),
       _compression(Compression::UNCOMPRESSED),
+      _compression_level(arrow::util::kUseDefaultCompressionLevel),
+      _tune_compression(false),
+      _compression_tuned(false),
+      _tuning_min_throughput(0),
+      _tuning_sample_fraction(1.0),
       _flush_rule(FlushRule::NROWS),
-      _data_pagesize(1024 * 1024 * 512) {
+      _write_mode(WriteMode::TABLE),
+      _durability(Durability::FLUSH),
+      _durability_n(1),
+      _rotation_rule(RotationRule::NONE),
+      _rotation_n(0),
+      _output_buffer_size(1024 * 1024 * 4),
+      _release_page_cache(false),
+      _preallocate(false),
+      _preallocation_hint(0),
+      _io_backend(IOBackend::DEFAULT),
+      _uring_queue_depth(4),
+      _data_pagesize(1024 * 1024),
+      _max_rows_per_page(0),
+      _page_index(false),
+      _statistics(true) {
     log = logging::get_logger();
 }
 
+Writer::~Writer() {
+    // the output files still being opened or closed in the background use
+    // the members, so all of them are waited for before any is destroyed
+    for (auto& [partition, pending_outputs] : _pending_outputs) {
+        for (auto& pending : pending_outputs) {
+            pending.wait();
+        }
+    }
+    for (auto& pending : _pending_closes) {
+        pending.wait();
+    }
+}
+
 const std::string Writer::compression2str(const Compression& compression) {
     std::string out = "";
     switch (compression) {
@@ -38,10 +111,107 @@ const std::string Writer::compression2str(const Compression& compression) {
             out = "SNAPPY";
             break;
         }
+        case Compression::ZSTD: {
+            out = "ZSTD";
+            break;
+        }
+        case Compression::LZ4: {
+            out = "LZ4";
+            break;
+        }
+        case Compression::BROTLI: {
+            out = "BROTLI";
+            break;
+        }
+    }
+    return out;
+}
+
+Compression Writer::str2compression(const std::string& compression) {
+    std::string name = compression;
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    for (const auto& candidate :
+         {Compression::UNCOMPRESSED, Compression::GZIP, Compression::SNAPPY,
+          Compression::ZSTD, Compression::LZ4, Compression::BROTLI}) {
+        if (compression2str(candidate) == name) {
+            return candidate;
+        }
+    }
+    throw parquetwriter::writer_exception("Unsupported compression \"" +
+                                          compression + "\"");
+}
+
+arrow::Compression::type Writer::arrow_compression(
+    const Compression& compression) {
+    auto out = arrow::Compression::UNCOMPRESSED;
+    switch (compression) {
+        case Compression::UNCOMPRESSED: {
+            out = arrow::Compression::UNCOMPRESSED;
+            break;
+        }
+        case Compression::GZIP: {
+            out = arrow::Compression::GZIP;
+            break;
+        }
+        case Compression::SNAPPY: {
+            out = arrow::Compression::SNAPPY;
+            break;
+        }
+        case Compression::ZSTD: {
+            out = arrow::Compression::ZSTD;
+            break;
+        }
+        case Compression::LZ4: {
+            // written as Parquet's (Hadoop-framed) LZ4 codec, there being no
+            // Parquet codec for the LZ4 frame format
+            out = arrow::Compression::LZ4;
+            break;
+        }
+        case Compression::BROTLI: {
+            out = arrow::Compression::BROTLI;
+            break;
+        }
     }
     return out;
 }
 
+void Writer::set_compression_tuning(
+    const double& min_throughput, const double& sample_fraction,
+    const std::vector<std::pair<Compression, int>>& candidates) {
+    if (!(sample_fraction > 0.0 && sample_fraction <= 1.0)) {
+        throw parquetwriter::writer_exception(
+            "The fraction of the RowGroup sampled for tuning the compression "
+            "must be within (0, 1]");
+    }
+    for (const auto& [compression, level] : candidates) {
+        if (level != arrow::util::kUseDefaultCompressionLevel &&
+            !arrow::util::Codec::SupportsCompressionLevel(
+                arrow_compression(compression))) {
+            throw parquetwriter::writer_exception(
+                "Compression " + compression2str(compression) +
+                " does not support setting a compression level");
+        }
+    }
+    _tune_compression = true;
+    _tuning_min_throughput = min_throughput;
+    _tuning_sample_fraction = sample_fraction;
+    _tuning_candidates = candidates;
+}
+
+void Writer::set_compression(const Compression& compression,
+                             const int& level) {
+    if (level != arrow::util::kUseDefaultCompressionLevel &&
+        !arrow::util::Codec::SupportsCompressionLevel(
+            arrow_compression(compression))) {
+        throw parquetwriter::writer_exception(
+            "Compression " + compression2str(compression) +
+            " does not support setting a compression level");
+    }
+    _compression = compression;
+    _compression_level = level;
+}
+
 const std::string Writer::flushrule2str(const FlushRule& flush_rule) {
     std::string out = "";
     switch (flush_rule) {
@@ -57,6 +227,78 @@ const std::string Writer::flushrule2str(const FlushRule& flush_rule) {
     return out;
 }
 
+const std::string Writer::writemode2str(const WriteMode& write_mode) {
+    std::string out = "";
+    switch (write_mode) {
+        case WriteMode::TABLE: {
+            out = "TABLE";
+            break;
+        }
+        case WriteMode::STREAM: {
+            out = "STREAM";
+            break;
+        }
+    }
+    return out;
+}
+
+const std::string Writer::durability2str(const Durability& durability) {
+    std::string out = "";
+    switch (durability) {
+        case Durability::NONE: {
+            out = "NONE";
+            break;
+        }
+        case Durability::FLUSH: {
+            out = "FLUSH";
+            break;
+        }
+        case Durability::FSYNC: {
+            out = "FSYNC";
+            break;
+        }
+    }
+    return out;
+}
+
+const std::string Writer::rotationrule2str(const RotationRule& rule) {
+    std::string out = "";
+    switch (rule) {
+        case RotationRule::NONE: {
+            out = "NONE";
+            break;
+        }
+        case RotationRule::NROWS: {
+            out = "N_ROWS";
+            break;
+        }
+        case RotationRule::NBYTES: {
+            out = "N_BYTES";
+            break;
+        }
+        case RotationRule::NSECONDS: {
+            out = "N_SECONDS";
+            break;
+        }
+    }
+    return out;
+}
+
+const std::string Writer::iobackend2str(const IOBackend& backend) {
+    std::string out = "";
+    switch (backend) {
+        case IOBackend::DEFAULT: {
+            out = "DEFAULT";
+            break;
+        }
+        case IOBackend::URING: {
+            out = "URING";
+            break;
+        }
+    }
+    return out;
+}
+
 void Writer::set_layout(std::ifstream& infile) {
     infile.seekg(0);
     nlohmann::json jlayout;
@@ -89,8 +331,13 @@ void Writer::set_layout(const nlohmann::json& field_layout) {
             "No fields constructed from provided layout");
     }
 
-    _schema = arrow::schema(_columns);
-    _arrays.clear();
+    // (half-precision floats are written as their bits where the parquet
+    // library does not support them)
+    std::vector<std::shared_ptr<arrow::Field>> storage_fields;
+    for (const auto& column : _columns) {
+        storage_fields.push_back(helpers::storage_field(column));
+    }
+    _schema = arrow::schema(storage_fields);
     if (!_file_metadata.empty()) {
         this->set_metadata(_file_metadata);
     }
@@ -99,6 +346,26 @@ void Writer::set_layout(const nlohmann::json& field_layout) {
     std::tie(_expected_fields_to_fill, _column_builder_map) =
         helpers::fill_field_builder_map_from_columns(_columns);
 
+    // the columns whose 32-bit offsets are watched for overflowing, and the
+    // columns/fields that fill them
+    _offset_watches.clear();
+    for (const auto& column : _columns) {
+        if (helpers::has_int32_offsets(column->type())) {
+            _offset_watches.push_back(
+                {column->name(),
+                 _column_builder_map.at(column->name()).at(column->name())});
+        }
+    }
+    _offset_watch_index.clear();
+    for (const auto& field : _expected_fields_to_fill) {
+        auto column_name = helpers::parent_column_name_from_field(field);
+        for (size_t iwatch = 0; iwatch < _offset_watches.size(); iwatch++) {
+            if (_offset_watches.at(iwatch).column_name == column_name) {
+                _offset_watch_index[field] = iwatch;
+            }
+        }
+    }
+
     _expected_fields_filltype_map.clear();
 
     log->debug("{0} - ============================================",
@@ -128,6 +395,105 @@ void Writer::set_layout(const nlohmann::json& field_layout) {
     for (const auto& field_to_fill : _expected_fields_to_fill) {
         _expected_field_fill_map[field_to_fill] = 0;
     }
+
+    // the columns whose values route the rows into key=value/ directories
+    _partition_columns =
+        helpers::partition_columns_from_json(field_layout, _columns);
+
+    // the columns by which the rows of each RowGroup are ordered
+    _sort_columns = helpers::sort_columns_from_json(field_layout, _columns);
+
+    // the compression settings of specific fields
+    _column_compression.clear();
+    for (const auto& [path, compression] :
+         helpers::column_compression_from_json(field_layout)) {
+        try {
+            _column_compression[path] = {
+                str2compression(compression.first), compression.second};
+        } catch (parquetwriter::writer_exception& e) {
+            throw parquetwriter::layout_exception(
+                "Invalid compression for field \"" + path + "\": " +
+                e.what());
+        }
+        if (compression.second != arrow::util::kUseDefaultCompressionLevel &&
+            !arrow::util::Codec::SupportsCompressionLevel(arrow_compression(
+                _column_compression.at(path).compression))) {
+            throw parquetwriter::layout_exception(
+                "Compression \"" + compression.first + "\" for field \"" +
+                path + "\" does not support setting a compression level");
+        }
+    }
+
+    // the encoding settings of specific fields
+    _column_encoding.clear();
+    for (const auto& [path, encoding] :
+         helpers::column_encoding_from_json(field_layout)) {
+        ColumnEncoding column_encoding;
+        if (!encoding.first.empty()) {
+            try {
+                column_encoding.encoding =
+                    helpers::parquet_encoding_from_string(encoding.first);
+            } catch (parquetwriter::layout_exception& e) {
+                throw parquetwriter::layout_exception(
+                    "Invalid encoding for field \"" + path + "\": " +
+                    e.what());
+            }
+        }
+        if (encoding.second >= 0) {
+            column_encoding.dictionary = encoding.second > 0;
+        }
+        _column_encoding[path] = column_encoding;
+    }
+
+    // the page index settings of specific fields
+    _column_page_index.clear();
+    for (const auto& [path, jpage_index] :
+         helpers::field_option_from_json(field_layout, "page_index")) {
+        if (!jpage_index.is_boolean()) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"page_index\" for field \"" + path +
+                "\", expected true or false");
+        }
+#ifndef PARQUETWRITER_HAVE_PAGE_INDEX
+        if (jpage_index.get<bool>()) {
+            throw parquetwriter::not_implemented_exception(
+                "Writing the page index (requested for field \"" + path +
+                "\") is not supported by the Arrow version parquet-writer "
+                "was built against");
+        }
+#endif
+        _column_page_index[path] = jpage_index.get<bool>();
+    }
+
+    // the number of mantissa bits kept for the floating point values of
+    // specific fields
+    _keep_mantissa_bits.clear();
+    for (const auto& [path, jkeep_bits] :
+         helpers::field_option_from_json(field_layout, "keep_mantissa_bits")) {
+        if (!jkeep_bits.is_number_integer() || jkeep_bits.get<int>() < 1 ||
+            jkeep_bits.get<int>() > 52) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"keep_mantissa_bits\" for field \"" + path +
+                "\", expected an integer between 1 and 52");
+        }
+        _keep_mantissa_bits[path] = jkeep_bits.get<int>();
+    }
+
+    // the statistics settings of specific fields
+    _column_statistics = helpers::column_statistics_from_json(field_layout);
+
+    // the bloom filters of specific fields
+    _column_bloom_filter.clear();
+    for (const auto& [path, bloom_filter] :
+         helpers::column_bloom_filter_from_json(field_layout)) {
+#ifndef PARQUETWRITER_HAVE_BLOOM_FILTER
+        throw parquetwriter::not_implemented_exception(
+            "Writing bloom filters (requested for field \"" + path +
+            "\") is not supported by the Arrow version parquet-writer was "
+            "built against");
+#endif
+        _column_bloom_filter[path] = {bloom_filter.first, bloom_filter.second};
+    }
 }
 
 void Writer::set_metadata(std::ifstream& infile) {
@@ -165,105 +531,1022 @@ void Writer::set_metadata(const nlohmann::json& metadata) {
             "Provided metadata JSON is missing top-level \"metadata\" node");
     }
 
-    if (_schema) {
-        std::unordered_map<std::string, std::string> metadata_map;
-        metadata_map["metadata"] = metadata["metadata"].dump();
-        arrow::KeyValueMetadata keyval_metadata(metadata_map);
-        _schema = _schema->WithMetadata(keyval_metadata.Copy());
+    if (_schema) {
+        std::unordered_map<std::string, std::string> metadata_map;
+        metadata_map["metadata"] = metadata["metadata"].dump();
+        arrow::KeyValueMetadata keyval_metadata(metadata_map);
+        _schema = _schema->WithMetadata(keyval_metadata.Copy());
+    }
+}
+
+void Writer::set_dataset_name(const std::string& dataset_name) {
+    _dataset_name = dataset_name;
+}
+
+void Writer::set_output_directory(const std::string& output_directory) {
+    _output_directory = output_directory;
+}
+
+void Writer::new_file(const std::string& partition) {
+    auto finished = std::move(_outputs.at(partition));
+    _outputs.erase(partition);
+    this->close_in_background(std::move(finished));
+
+    // files in partition directories are only opened once there are rows
+    // to write to them
+    if (partition.empty()) {
+        this->update_output_stream(partition);
+    }
+}
+
+void Writer::close_in_background(std::vector<OutputFile> outputs) {
+    // the files are closed while the filling goes on, alongside any earlier
+    // batches of files that are still being closed, up to a few batches at
+    // once (beyond which the filling waits for the oldest one)
+    constexpr size_t max_pending_closes = 4;
+    this->collect_closed(false);
+    while (_pending_closes.size() >= max_pending_closes) {
+        this->add_closed_stats(_pending_closes.front().get());
+        _pending_closes.erase(_pending_closes.begin());
+    }
+    _pending_closes.push_back(std::async(
+        std::launch::async, [this, outputs = std::move(outputs)]() mutable {
+            WriterStats closed_stats;
+            for (auto& output : outputs) {
+                std::string path = output.path;
+                std::shared_ptr<arrow::Buffer> buffer;
+                auto stats =
+                    this->close_output_file(std::move(output), &buffer);
+                if (buffer && _buffer_callback) {
+                    std::lock_guard<std::mutex> lock(_buffer_callback_mutex);
+                    _buffer_callback(path, buffer);
+                }
+                closed_stats += stats;
+            }
+            return closed_stats;
+        }));
+}
+
+void Writer::close_stale_partitions() {
+    if (_outputs.size() <= _max_open_partitions) return;
+
+    std::vector<std::pair<uint64_t, std::string>> by_last_use;
+    for (const auto& [partition, outputs] : _outputs) {
+        by_last_use.push_back({outputs.front().last_row_group, partition});
+    }
+    std::sort(by_last_use.begin(), by_last_use.end());
+
+    std::vector<OutputFile> stale;
+    size_t n_stale = _outputs.size() - _max_open_partitions;
+    for (size_t i = 0; i < n_stale; i++) {
+        const auto& partition = by_last_use.at(i).second;
+        for (auto& output : _outputs.at(partition)) {
+            stale.push_back(std::move(output));
+        }
+        _outputs.erase(partition);
+    }
+    this->close_in_background(std::move(stale));
+}
+
+bool Writer::rotation_due(const std::vector<OutputFile>& outputs) const {
+    bool due = false;
+    for (const auto& output : outputs) {
+        switch (_rotation_rule) {
+            case RotationRule::NONE: {
+                break;
+            }
+            case RotationRule::NROWS: {
+                due = due || output.n_rows >= _rotation_n;
+                break;
+            }
+            case RotationRule::NBYTES: {
+                int64_t position = 0;
+                PARQUET_ASSIGN_OR_THROW(position, output.stream->Tell());
+                due = due || static_cast<uint64_t>(position) >= _rotation_n;
+                break;
+            }
+            case RotationRule::NSECONDS: {
+                auto elapsed =
+                    std::chrono::steady_clock::now() - output.open_time;
+                due = due || elapsed >= std::chrono::seconds(_rotation_n);
+                break;
+            }
+        }
+    }
+    return due;
+}
+
+std::string Writer::output_filename(const std::string& partition,
+                                    size_t shard) const {
+    std::stringstream output_filename;
+    if (!partition.empty()) {
+        output_filename << partition << "/";
+    }
+
+    // files are numbered whenever there may be more than one of them
+    bool numbered =
+        _rotation_rule != RotationRule::NONE || !_partition_columns.empty();
+    output_filename << _dataset_name;
+    if (numbered) {
+        uint32_t file_count =
+            _file_counts.count(partition) ? _file_counts.at(partition) : 0;
+        output_filename << "_" << std::setfill('0') << std::setw(4)
+                        << file_count;
+    }
+    if (_shard_schemas.size() > 1) {
+        output_filename << ".shard" << std::setfill('0') << std::setw(2)
+                        << shard;
+    }
+    output_filename << ".parquet";
+    return output_filename.str();
+}
+
+void Writer::update_output_stream(const std::string& partition) {
+    int64_t preallocation = this->preallocation_size();
+    auto& pending_outputs = _pending_outputs[partition];
+    for (size_t shard = 0; shard < _shard_schemas.size(); shard++) {
+        pending_outputs.push_back(std::async(
+            std::launch::async, &Writer::open_output_file, this, partition,
+            shard, this->output_filename(partition, shard), preallocation));
+    }
+    _file_counts[partition]++;
+}
+
+int64_t Writer::preallocation_size() {
+    if (!_preallocate) return 0;
+    if (_preallocation_hint > 0) return _preallocation_hint;
+
+    int64_t size = 0;
+    switch (_rotation_rule) {
+        case RotationRule::NBYTES: {
+            size = _rotation_n;
+            break;
+        }
+        case RotationRule::NROWS: {
+            // estimated from what has been written so far (nothing is
+            // reserved for the very first files), split across the shards
+            auto stats = this->stats();
+            if (stats.rows_written > 0) {
+                double bytes_per_row =
+                    static_cast<double>(stats.bytes_written) /
+                    stats.rows_written / _shard_schemas.size();
+                size = static_cast<int64_t>(1.1 * bytes_per_row * _rotation_n);
+            }
+            break;
+        }
+        case RotationRule::NONE:
+        case RotationRule::NSECONDS: {
+            size = 0;
+            break;
+        }
+    }
+    return size;
+}
+
+std::vector<Writer::OutputFile>& Writer::output(const std::string& partition) {
+    if (_outputs.count(partition) == 0) {
+        if (_pending_outputs.count(partition) == 0) {
+            this->update_output_stream(partition);
+        }
+        auto& outputs = _outputs[partition];
+        for (auto& pending_output : _pending_outputs.at(partition)) {
+            outputs.push_back(pending_output.get());
+        }
+        _pending_outputs.erase(partition);
+    }
+    return _outputs.at(partition);
+}
+
+void Writer::collect_closed(bool wait) {
+    auto pending = _pending_closes.begin();
+    while (pending != _pending_closes.end()) {
+        if (wait || pending->wait_for(std::chrono::seconds(0)) ==
+                        std::future_status::ready) {
+            this->add_closed_stats(pending->get());
+            pending = _pending_closes.erase(pending);
+        } else {
+            pending++;
+        }
+    }
+}
+
+void Writer::add_closed_stats(const WriterStats& closed_stats) {
+    _stats += closed_stats;
+}
+
+Writer::OutputFile Writer::open_output_file(const std::string& partition,
+                                            size_t shard,
+                                            const std::string& filename,
+                                            int64_t preallocation) const {
+    OutputFile output;
+    output.path = filename;
+
+    std::shared_ptr<arrow::io::OutputStream> raw_stream;
+    if (_output_sink == OutputSink::BUFFER) {
+        PARQUET_ASSIGN_OR_THROW(output.buffer_stream,
+                                arrow::io::BufferOutputStream::Create());
+        raw_stream = output.buffer_stream;
+    } else if (_output_sink == OutputSink::STREAM) {
+        raw_stream = _user_stream;
+    } else if (!partition.empty()) {
+        PARQUET_THROW_NOT_OK(_internal_fs->CreateDir(partition));
+    }
+
+    if (!raw_stream && _io_backend == IOBackend::URING) {
+        auto uring_stream = streams::UringOutputStream::Open(
+            _output_path + "/" + filename,
+            std::max<int64_t>(_output_buffer_size, 1024 * 1024),
+            _uring_queue_depth);
+        if (uring_stream.ok()) {
+            raw_stream = *uring_stream;
+        } else {
+            log->warn("{0} - Failed to open \"{1}\" with io_uring ({2}), "
+                      "falling back to the default output stream",
+                      __PRETTYFUNCTION__, filename,
+                      uring_stream.status().ToString());
+        }
+    }
+    if (!raw_stream) {
+        PARQUET_ASSIGN_OR_THROW(raw_stream,
+                                _internal_fs->OpenOutputStream(filename));
+    }
+    output.file_stream =
+        std::make_shared<streams::CountingOutputStream>(raw_stream);
+
+    // reserve the space for the whole file up front so that it is laid out
+    // contiguously on disk, rather than extended bit by bit alongside the
+    // other files being written
+    int fd = streams::file_descriptor(raw_stream);
+    if (preallocation > 0 && fd >= 0) {
+        output.preallocated = streams::preallocate(fd, preallocation);
+        if (!output.preallocated) {
+            log->debug("{0} - Failed to preallocate {1} bytes for \"{2}\"",
+                       __PRETTYFUNCTION__, preallocation, filename);
+        }
+    }
+
+    // user-space buffering in front of the file, so that the many small
+    // page writes coming from the Parquet writer are coalesced (the io_uring
+    // stream buffers the writes itself, and in-memory output needs none)
+    output.stream = output.file_stream;
+    bool self_buffered =
+        std::dynamic_pointer_cast<streams::UringOutputStream>(raw_stream) ||
+        output.buffer_stream;
+    if (_output_buffer_size > 0 && !self_buffered) {
+        PARQUET_ASSIGN_OR_THROW(
+            output.stream, arrow::io::BufferedOutputStream::Create(
+                               _output_buffer_size,
+                               arrow::default_memory_pool(), output.file_stream));
+    }
+
+    if (_durability == Durability::FSYNC &&
+        _output_sink != OutputSink::BUFFER &&
+        streams::file_descriptor(output.file_stream) < 0) {
+        log->warn(
+            "{0} - Output stream for \"{1}\" is not backed by a local file, "
+            "durability policy {2} will only flush the stream",
+            __PRETTYFUNCTION__, filename, durability2str(_durability));
+    }
+
+    auto writer_properties = _writer_properties;
+#ifdef PARQUETWRITER_HAVE_SORTING_COLUMNS
+    // record the order of the rows in the RowGroup metadata, by the index of
+    // the sort columns within this shard (as far as the shard holds them)
+    if (!_sort_columns.empty()) {
+        std::shared_ptr<parquet::SchemaDescriptor> parquet_schema;
+        PARQUET_THROW_NOT_OK(parquet::arrow::ToParquetSchema(
+            _shard_schemas.at(shard).get(), *_writer_properties,
+            *_arrow_writer_properties, &parquet_schema));
+        std::vector<parquet::SortingColumn> sorting_columns;
+        for (const auto& sort_column : _sort_columns) {
+            int icolumn = parquet_schema->ColumnIndex(sort_column);
+            if (icolumn < 0) break;
+            parquet::SortingColumn sorting_column;
+            sorting_column.column_idx = icolumn;
+            sorting_column.descending = false;
+            sorting_column.nulls_first = false;
+            sorting_columns.push_back(sorting_column);
+        }
+        parquet::WriterProperties::Builder properties_builder;
+        this->configure_writer_properties(properties_builder);
+        properties_builder.set_sorting_columns(sorting_columns);
+        writer_properties = properties_builder.build();
+    }
+#endif
+
+    PARQUET_THROW_NOT_OK(parquet::arrow::FileWriter::Open(
+        *_shard_schemas.at(shard), arrow::default_memory_pool(), output.stream,
+        writer_properties, _arrow_writer_properties, &output.file_writer));
+
+    output.open_time = std::chrono::steady_clock::now();
+    output.last_sync_time = output.open_time;
+    return output;
+}
+
+WriterStats Writer::close_output_file(
+    OutputFile output, std::shared_ptr<arrow::Buffer>* finished_buffer) const {
+    WriterStats stats;
+    PARQUET_THROW_NOT_OK(output.file_writer->Close());
+
+    // the footer has been written, make sure that it reaches the file
+    // before closing it
+    if (_durability == Durability::FSYNC) {
+        this->sync_output(output, true, stats);
+    }
+    if (_release_page_cache || output.preallocated) {
+        PARQUET_THROW_NOT_OK(output.stream->Flush());
+    }
+    if (_release_page_cache) {
+        this->release_page_cache(output, true);
+    }
+
+    // give back the reserved space beyond the end of the file
+    int fd = streams::file_descriptor(output.file_stream);
+    if (output.preallocated && fd >= 0) {
+        streams::truncate(fd, output.file_stream->n_bytes());
+    }
+
+    // the user-provided stream is left open for the caller (the buffered
+    // stream in front of it is detached from it, as it would otherwise close
+    // it when destroyed)
+    if (_output_sink == OutputSink::STREAM && !_close_user_stream) {
+        if (auto buffered =
+                std::dynamic_pointer_cast<arrow::io::BufferedOutputStream>(
+                    output.stream)) {
+            std::shared_ptr<arrow::io::OutputStream> raw;
+            PARQUET_ASSIGN_OR_THROW(raw, buffered->Detach());
+            PARQUET_THROW_NOT_OK(raw->Flush());
+        } else {
+            PARQUET_THROW_NOT_OK(output.stream->Flush());
+        }
+    } else {
+        PARQUET_THROW_NOT_OK(output.stream->Close());
+    }
+
+    // hand over the in-memory file without copying it
+    if (output.buffer_stream) {
+        std::shared_ptr<arrow::Buffer> buffer;
+        PARQUET_ASSIGN_OR_THROW(buffer, output.buffer_stream->Finish());
+        if (finished_buffer) {
+            *finished_buffer = buffer;
+        }
+    }
+
+    stats.files_written = 1;
+    stats.bytes_written = output.file_stream->n_bytes();
+    stats.n_writes = output.file_stream->n_writes();
+
+#ifdef PARQUETWRITER_HAVE_BLOOM_FILTER
+    // the space taken up by the bloom filters, from the file's footer
+    if (!_column_bloom_filter.empty()) {
+        auto metadata = output.file_writer->metadata();
+        for (int igroup = 0; igroup < metadata->num_row_groups(); igroup++) {
+            auto row_group = metadata->RowGroup(igroup);
+            for (int icolumn = 0; icolumn < row_group->num_columns();
+                 icolumn++) {
+                auto length = row_group->ColumnChunk(icolumn)
+                                  ->bloom_filter_length();
+                if (length) {
+                    stats.n_bloom_filters++;
+                    stats.bloom_filter_bytes += length.value();
+                }
+            }
+        }
+    }
+#endif
+    return stats;
+}
+
+void Writer::initialize() {
+    if (_dataset_name.empty()) {
+        throw parquetwriter::writer_exception("Empty dataset name");
+    }
+
+    if (!_schema) {
+        throw parquetwriter::writer_exception("Empty Parquet schema");
+    }
+
+    if (_columns.size() == 0) {
+        throw parquetwriter::writer_exception("Empty file layout (no columns)");
+    }
+
+    //
+    // create the output path and filesystem handler (unless the output is
+    // written elsewhere)
+    //
+    if (_output_sink == OutputSink::FILES) {
+        std::string internal_path;
+        _fs = arrow::fs::FileSystemFromUriOrPath(
+                  std::filesystem::absolute(_output_directory), &internal_path)
+                  .ValueOrDie();
+        PARQUET_THROW_NOT_OK(_fs->CreateDir(internal_path));
+        _internal_fs =
+            std::make_shared<arrow::fs::SubTreeFileSystem>(internal_path, _fs);
+        _output_path = internal_path;
+    }
+
+    // the pipe is opened here, as opening a named pipe waits for the
+    // process reading from it
+    if (!_output_pipe.empty()) {
+        std::shared_ptr<arrow::io::FileOutputStream> pipe_stream;
+        if (_output_pipe == "-") {
+            // a duplicate, so that closing the stream leaves stdout open;
+            // the log messages must then stay off of stdout
+            logging::log_to_stderr();
+            int fd = ::dup(STDOUT_FILENO);
+            if (fd < 0) {
+                throw parquetwriter::writer_exception(
+                    "Failed to duplicate stdout for the output pipe: " +
+                    std::string(std::strerror(errno)));
+            }
+            PARQUET_ASSIGN_OR_THROW(pipe_stream,
+                                    arrow::io::FileOutputStream::Open(fd));
+        } else {
+            PARQUET_ASSIGN_OR_THROW(
+                pipe_stream, arrow::io::FileOutputStream::Open(_output_pipe));
+        }
+        _user_stream = pipe_stream;
+    }
+
+    // a user-provided stream can only take a single output file
+    if (_output_sink == OutputSink::STREAM &&
+        (_rotation_rule != RotationRule::NONE ||
+         !_partition_columns.empty() || _n_shards > 1)) {
+        throw parquetwriter::writer_exception(
+            "Output to a user-provided stream cannot be combined with file "
+            "rotation, partitioning, or sharding");
+    }
+
+    // without a callback, only the last of several in-memory files could
+    // be handed back (by finish())
+    if (_output_sink == OutputSink::BUFFER && !_buffer_callback &&
+        (_rotation_rule != RotationRule::NONE ||
+         !_partition_columns.empty() || _n_shards > 1)) {
+        throw parquetwriter::writer_exception(
+            "Output to memory combined with file rotation, partitioning, or "
+            "sharding requires a callback to receive each of the files");
+    }
+
+    // io_uring needs a local file and kernel support
+    if (_io_backend == IOBackend::URING &&
+        (_output_sink != OutputSink::FILES || _fs->type_name() != "local" ||
+         !streams::UringOutputStream::available())) {
+        log->warn(
+            "{0} - I/O backend {1} is not available for output directory "
+            "\"{2}\", falling back to {3}",
+            __PRETTYFUNCTION__, iobackend2str(_io_backend), _output_directory,
+            iobackend2str(IOBackend::DEFAULT));
+        _io_backend = IOBackend::DEFAULT;
+    }
+
+    //
+    // default RowGroup specification for now (need to make configurable)
+    //
+    if (_n_rows_in_group < 0) {
+        _n_rows_in_group = 250000 / _expected_fields_to_fill.size();
+    }
+
+    //
+    // create the Parquet writer properties, shared by all output files
+    //
+
+    _arrow_writer_properties =
+        parquet::ArrowWriterProperties::Builder().store_schema()->build();
+
+    parquet::WriterProperties::Builder properties_builder;
+    this->configure_writer_properties(properties_builder);
+    _writer_properties = properties_builder.build();
+
+    // mantissa bits can only be dropped from floating point values
+    std::vector<std::string> truncated_fields;
+    for (const auto& setting : _keep_mantissa_bits) {
+        truncated_fields.push_back(setting.first);
+    }
+    std::set<std::string> floating_point_fields;
+    this->for_each_leaf_column(
+        truncated_fields, "Mantissa truncation",
+        [&floating_point_fields](const parquet::ColumnDescriptor* column,
+                                 const std::string& path) {
+            if (column->physical_type() == parquet::Type::FLOAT ||
+                column->physical_type() == parquet::Type::DOUBLE) {
+                floating_point_fields.insert(path);
+            }
+        });
+    for (const auto& path : truncated_fields) {
+        if (floating_point_fields.count(path) == 0) {
+            throw parquetwriter::layout_exception(
+                "\"keep_mantissa_bits\" given for field \"" + path +
+                "\", which holds no floating point values");
+        }
+    }
+
+    //
+    // the layout of the data actually stored in the output file(s)
+    //
+    this->assign_shards();
+
+    // create the output stream and Parquet writer at the new location,
+    // waiting for it here so that any problems are reported right away
+    // (files in partition directories are opened as rows arrive for them,
+    // and when tuning the compression the files are only opened once it
+    // has been chosen)
+    _file_counts.clear();
+    _compression_tuned = false;
+    _tuned_compression.clear();
+    if (_partition_columns.empty() && !_tune_compression) {
+        this->output();
+    }
+}
+
+void Writer::configure_writer_properties(
+    parquet::WriterProperties::Builder& builder) const {
+    builder.compression(arrow_compression(_compression))
+        ->compression_level(_compression_level);
+
+    // nanosecond timestamps need the format version that introduced them,
+    // otherwise they would be coerced to microseconds
+    bool nanosecond_timestamps = false;
+    for (const auto& column : _columns) {
+        if (helpers::has_nanosecond_timestamps(column->type())) {
+            nanosecond_timestamps = true;
+        }
+    }
+    if (nanosecond_timestamps) {
+#ifdef PARQUETWRITER_HAVE_PARQUET_2_6
+        builder.version(parquet::ParquetVersion::PARQUET_2_6);
+#else
+        builder.version(parquet::ParquetVersion::PARQUET_2_0);
+#endif
+    }
+    this->apply_column_compression(builder);
+    this->apply_column_encoding(builder);
+    this->apply_column_statistics(builder);
+    this->apply_column_bloom_filter(builder);
+    this->apply_page_settings(builder);
+}
+
+void Writer::tune_compression(
+    const std::map<std::string, std::shared_ptr<arrow::Array>>& arrays) {
+    // the columns are encoded as they would be in the output, but without
+    // compression, giving the bytes that the candidates are tried on
+    parquet::WriterProperties::Builder trial_builder;
+    this->configure_writer_properties(trial_builder);
+    trial_builder.compression(arrow::Compression::UNCOMPRESSED);
+    auto trial_properties = trial_builder.build();
+
+    auto candidates = _tuning_candidates;
+    if (candidates.empty()) {
+        candidates = {{Compression::SNAPPY, 0}, {Compression::LZ4, 0},
+                      {Compression::ZSTD, 1},   {Compression::ZSTD, 3},
+                      {Compression::ZSTD, 9},   {Compression::GZIP, 6},
+                      {Compression::BROTLI, 1}};
+        for (auto& [compression, level] : candidates) {
+            if (!arrow::util::Codec::SupportsCompressionLevel(
+                    arrow_compression(compression))) {
+                level = arrow::util::kUseDefaultCompressionLevel;
+            }
+        }
+    }
+
+    nlohmann::json jchoices = nlohmann::json::object();
+    for (const auto& column : _columns) {
+        const auto& name = column->name();
+        if (!this->column_in_files(name)) continue;
+
+        // the compression given in the layout takes precedence
+        bool in_layout = std::any_of(
+            _column_compression.begin(), _column_compression.end(),
+            [&name](const auto& setting) {
+                return setting.first == name ||
+                       setting.first.rfind(name + ".", 0) == 0;
+            });
+        if (in_layout) continue;
+
+        auto array = arrays.at(name);
+        int64_t n_sample = std::max<int64_t>(
+            1, static_cast<int64_t>(array->length() * _tuning_sample_fraction));
+        auto encoded = helpers::encoded_column(
+            _schema->GetFieldByName(name), array->Slice(0, n_sample),
+            trial_properties, _arrow_writer_properties);
+
+        // uncompressed output is the fallback when no candidate is fast enough
+        ColumnCompression choice = {Compression::UNCOMPRESSED,
+                                    arrow::util::kUseDefaultCompressionLevel};
+        double best_ratio = 1.0;
+        double best_throughput = 0.0;
+        for (const auto& [compression, level] : candidates) {
+            if (!arrow::util::Codec::IsAvailable(
+                    arrow_compression(compression))) {
+                continue;
+            }
+            auto [ratio, throughput] = helpers::trial_compress(
+                *encoded, arrow_compression(compression), level);
+            if (throughput < _tuning_min_throughput) continue;
+            if (ratio > best_ratio ||
+                (ratio == best_ratio && throughput > best_throughput)) {
+                choice = {compression, level};
+                best_ratio = ratio;
+                best_throughput = throughput;
+            }
+        }
+        _tuned_compression[name] = choice;
+
+        std::string label = compression2str(choice.compression);
+        if (choice.level != arrow::util::kUseDefaultCompressionLevel) {
+            label += "(" + std::to_string(choice.level) + ")";
+        }
+        _stats.column_compression[name] = label;
+        jchoices[name] = {{"codec", compression2str(choice.compression)},
+                          {"ratio", best_ratio},
+                          {"throughput", best_throughput}};
+        if (choice.level != arrow::util::kUseDefaultCompressionLevel) {
+            jchoices[name]["level"] = choice.level;
+        }
+        log->debug("{0} - Column \"{1}\": chose {2} (ratio {3:.2f})",
+                   __PRETTYFUNCTION__, name, label, best_ratio);
+    }
+
+    parquet::WriterProperties::Builder properties_builder;
+    this->configure_writer_properties(properties_builder);
+    _writer_properties = properties_builder.build();
+
+    // record the choices in each file's metadata
+    for (auto& shard_schema : _shard_schemas) {
+        auto metadata = shard_schema->metadata()
+                            ? shard_schema->metadata()->Copy()
+                            : std::make_shared<arrow::KeyValueMetadata>();
+        metadata->Append("compression", jchoices.dump());
+        shard_schema = shard_schema->WithMetadata(metadata);
+    }
+    _compression_tuned = true;
+}
+
+void Writer::for_each_leaf_column(
+    const std::vector<std::string>& field_paths, const std::string& setting,
+    const std::function<void(const parquet::ColumnDescriptor*,
+                             const std::string&)>& apply) const {
+    if (field_paths.empty()) return;
+
+    std::vector<std::string> by_depth = field_paths;
+    std::stable_sort(by_depth.begin(), by_depth.end(),
+                     [](const auto& lhs, const auto& rhs) {
+                         return std::count(lhs.begin(), lhs.end(), '.') <
+                                std::count(rhs.begin(), rhs.end(), '.');
+                     });
+
+    std::shared_ptr<parquet::SchemaDescriptor> parquet_schema;
+    PARQUET_THROW_NOT_OK(parquet::arrow::ToParquetSchema(
+        _schema.get(), *parquet::default_writer_properties(),
+        *_arrow_writer_properties, &parquet_schema));
+
+    std::set<std::string> matched;
+    for (int icolumn = 0; icolumn < parquet_schema->num_columns(); icolumn++) {
+        auto column = parquet_schema->Column(icolumn);
+        auto field_path = helpers::leaf_field_path(column);
+        for (const auto& path : by_depth) {
+            if (field_path == path || field_path.rfind(path + ".", 0) == 0) {
+                apply(column, path);
+                matched.insert(path);
+            }
+        }
+    }
+
+    for (const auto& path : field_paths) {
+        if (matched.count(path) == 0) {
+            throw parquetwriter::layout_exception(
+                setting + " specified for unknown field \"" + path + "\"");
+        }
+    }
+}
+
+void Writer::apply_column_compression(
+    parquet::WriterProperties::Builder& builder) const {
+    // the codecs chosen by tuning only cover the columns without one in the
+    // layout
+    auto settings = _column_compression;
+    settings.insert(_tuned_compression.begin(), _tuned_compression.end());
+
+    std::vector<std::string> field_paths;
+    for (const auto& setting : settings) {
+        field_paths.push_back(setting.first);
+    }
+    this->for_each_leaf_column(
+        field_paths, "Compression",
+        [&settings, &builder](const parquet::ColumnDescriptor* column,
+                              const std::string& path) {
+            const auto& column_compression = settings.at(path);
+            auto column_path = column->path()->ToDotString();
+            builder.compression(
+                column_path, arrow_compression(column_compression.compression));
+            builder.compression_level(column_path, column_compression.level);
+        });
+}
+
+void Writer::apply_column_encoding(
+    parquet::WriterProperties::Builder& builder) const {
+    std::vector<std::string> field_paths;
+    for (const auto& setting : _column_encoding) {
+        field_paths.push_back(setting.first);
+    }
+    this->for_each_leaf_column(
+        field_paths, "Encoding",
+        [this, &builder](const parquet::ColumnDescriptor* column,
+                         const std::string& path) {
+            const auto& column_encoding = _column_encoding.at(path);
+            auto column_path = column->path()->ToDotString();
+            if (column_encoding.encoding) {
+                // not every encoding is implemented (by this version of
+                // Arrow) for every physical type, which would otherwise
+                // only be found out when writing
+                auto encoding = column_encoding.encoding.value();
+                try {
+                    parquet::MakeEncoder(column->physical_type(), encoding,
+                                         false, column);
+                } catch (parquet::ParquetException& e) {
+                    throw parquetwriter::layout_exception(
+                        "Encoding " + parquet::EncodingToString(encoding) +
+                        " is not supported for column \"" + column_path +
+                        "\" of field \"" + path + "\" (physical type " +
+                        parquet::TypeToString(column->physical_type()) + ")");
+                }
+                builder.encoding(column_path, encoding);
+            }
+            if (column_encoding.dictionary.value_or(
+                    !column_encoding.encoding.has_value())) {
+                builder.enable_dictionary(column_path);
+            } else {
+                builder.disable_dictionary(column_path);
+            }
+        });
+}
+
+void Writer::apply_column_statistics(
+    parquet::WriterProperties::Builder& builder) const {
+    if (_statistics) {
+        builder.enable_statistics();
+    } else {
+        builder.disable_statistics();
+    }
+
+    std::vector<std::string> field_paths;
+    for (const auto& setting : _column_statistics) {
+        field_paths.push_back(setting.first);
+    }
+    this->for_each_leaf_column(
+        field_paths, "Statistics",
+        [this, &builder](const parquet::ColumnDescriptor* column,
+                         const std::string& path) {
+            if (_column_statistics.at(path)) {
+                builder.enable_statistics(column->path());
+            } else {
+                builder.disable_statistics(column->path());
+            }
+        });
+}
+
+void Writer::apply_column_bloom_filter(
+    parquet::WriterProperties::Builder& builder) const {
+#ifdef PARQUETWRITER_HAVE_BLOOM_FILTER
+    std::vector<std::string> field_paths;
+    for (const auto& setting : _column_bloom_filter) {
+        field_paths.push_back(setting.first);
+    }
+    this->for_each_leaf_column(
+        field_paths, "Bloom filter",
+        [this, &builder](const parquet::ColumnDescriptor* column,
+                         const std::string& path) {
+            const auto& bloom_filter = _column_bloom_filter.at(path);
+            parquet::BloomFilterOptions options;
+            if (bloom_filter.ndv > 0) {
+                options.ndv = bloom_filter.ndv;
+            }
+            options.fpp = bloom_filter.fpp;
+            builder.enable_bloom_filter(column->path(), options);
+        });
+#else
+    (void)builder;
+#endif
+}
+
+void Writer::apply_page_settings(
+    parquet::WriterProperties::Builder& builder) const {
+    builder.data_pagesize(_data_pagesize);
+#ifdef PARQUETWRITER_HAVE_MAX_ROWS_PER_PAGE
+    if (_max_rows_per_page > 0) {
+        builder.max_rows_per_page(_max_rows_per_page);
+    }
+#endif
+
+#ifdef PARQUETWRITER_HAVE_PAGE_INDEX
+    if (_page_index) {
+        builder.enable_write_page_index();
+    } else {
+        builder.disable_write_page_index();
+    }
+    std::vector<std::string> field_paths;
+    for (const auto& setting : _column_page_index) {
+        field_paths.push_back(setting.first);
+    }
+    this->for_each_leaf_column(
+        field_paths, "Page index",
+        [this, &builder](const parquet::ColumnDescriptor* column,
+                         const std::string& path) {
+            if (_column_page_index.at(path)) {
+                builder.enable_write_page_index(column->path());
+            } else {
+                builder.disable_write_page_index(column->path());
+            }
+        });
+#endif
+}
+
+void Writer::assign_shards() {
+    std::vector<std::shared_ptr<arrow::Field>> stored_columns;
+    for (const auto& column : _columns) {
+        if (this->column_in_files(column->name())) {
+            stored_columns.push_back(column);
+        }
+    }
+
+    _shard_columns.clear();
+    if (!_shard_layout.empty()) {
+        _shard_columns =
+            helpers::check_shard_layout(_shard_layout, stored_columns);
+    } else if (_n_shards > 1) {
+        _shard_columns = helpers::balance_columns(stored_columns, _n_shards);
+    } else {
+        _shard_columns.push_back({});
+        for (const auto& column : stored_columns) {
+            _shard_columns.back().push_back(column->name());
+        }
+    }
+
+    _shard_schemas.clear();
+    if (_shard_columns.size() == 1) {
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        for (const auto& column_name : _shard_columns.front()) {
+            fields.push_back(_schema->GetFieldByName(column_name));
+        }
+        _shard_schemas.push_back(arrow::schema(fields, _schema->metadata()));
+        return;
+    }
+
+    // each shard leads with the row index, and records its place among the
+    // shards in its metadata
+    if (_schema->GetFieldIndex(ROW_INDEX_COLUMN) >= 0) {
+        throw parquetwriter::layout_exception(
+            "Column name \"" + ROW_INDEX_COLUMN +
+            "\" is reserved for the row index of sharded output");
+    }
+    for (size_t shard = 0; shard < _shard_columns.size(); shard++) {
+        std::vector<std::shared_ptr<arrow::Field>> fields = {
+            arrow::field(ROW_INDEX_COLUMN, arrow::int64(), false)};
+        for (const auto& column_name : _shard_columns.at(shard)) {
+            fields.push_back(_schema->GetFieldByName(column_name));
+        }
+
+        auto metadata = _schema->metadata()
+                            ? _schema->metadata()->Copy()
+                            : std::make_shared<arrow::KeyValueMetadata>();
+        nlohmann::json jshard = {{"index", shard},
+                                 {"count", _shard_columns.size()},
+                                 {"columns", _shard_columns.at(shard)}};
+        metadata->Append("shard", jshard.dump());
+        _shard_schemas.push_back(arrow::schema(fields, metadata));
+        _shard_columns.at(shard).insert(_shard_columns.at(shard).begin(),
+                                        ROW_INDEX_COLUMN);
+    }
+}
+
+void Writer::set_shards(const uint32_t& n) {
+    if (n == 0) {
+        throw parquetwriter::writer_exception(
+            "The number of shards must be non-zero");
+    }
+    _n_shards = n;
+    _shard_layout.clear();
+}
+
+void Writer::set_shards(const std::vector<std::vector<std::string>>& shards) {
+    if (shards.empty()) {
+        throw parquetwriter::writer_exception(
+            "The shard layout must hold at least one shard");
+    }
+    _n_shards = shards.size();
+    _shard_layout = shards;
+}
+
+void Writer::set_io_backend(const IOBackend& backend,
+                            const uint32_t& queue_depth) {
+    if (queue_depth == 0) {
+        throw parquetwriter::writer_exception(
+            "The io_uring queue depth must be non-zero");
     }
+    _io_backend = backend;
+    _uring_queue_depth = queue_depth;
 }
 
-void Writer::set_dataset_name(const std::string& dataset_name) {
-    _dataset_name = dataset_name;
+void Writer::set_max_rows_per_page(const int64_t& max_rows) {
+#ifndef PARQUETWRITER_HAVE_MAX_ROWS_PER_PAGE
+    if (max_rows > 0) {
+        throw parquetwriter::not_implemented_exception(
+            "Limiting the number of rows per page is not supported by the "
+            "Arrow version parquet-writer was built against");
+    }
+#endif
+    if (max_rows < 0) {
+        throw parquetwriter::writer_exception(
+            "The maximum number of rows per page must not be negative");
+    }
+    _max_rows_per_page = max_rows;
 }
 
-void Writer::set_output_directory(const std::string& output_directory) {
-    _output_directory = output_directory;
+void Writer::set_page_index(const bool& page_index) {
+#ifndef PARQUETWRITER_HAVE_PAGE_INDEX
+    if (page_index) {
+        throw parquetwriter::not_implemented_exception(
+            "Writing the page index is not supported by the Arrow version "
+            "parquet-writer was built against");
+    }
+#endif
+    _page_index = page_index;
 }
 
-void Writer::new_file() {
-    throw parquetwriter::not_implemented_exception(
-        "Dataset partitioning is not implemented!");
-    this->update_output_stream();
-    this->initialize();
+void Writer::set_preallocation(const bool& preallocate,
+                               const uint64_t& size_hint) {
+    _preallocate = preallocate;
+    _preallocation_hint = size_hint;
 }
 
-void Writer::update_output_stream() {
-    std::stringstream output_filename;
-    output_filename << _dataset_name << ".parquet";
-    // TODO: setup partioning of datasets
-    // output_filename << _dataset_name << "_" << std::setfill('0') <<
-    // std::setw(4)
-    //                << _file_count << ".parquet";
-    PARQUET_ASSIGN_OR_THROW(
-        _output_stream, _internal_fs->OpenOutputStream(output_filename.str()));
-    _file_count++;
+void Writer::set_output_to_buffer(const BufferCallback& callback) {
+    _output_sink = OutputSink::BUFFER;
+    _user_stream = nullptr;
+    _buffer_callback = callback;
+    _output_pipe = "";
 }
 
-void Writer::initialize() {
-    if (_dataset_name.empty()) {
-        throw parquetwriter::writer_exception("Empty dataset name");
+void Writer::set_output_stream(
+    std::shared_ptr<arrow::io::OutputStream> stream) {
+    if (!stream) {
+        throw parquetwriter::writer_exception("Null output stream provided");
     }
+    _output_sink = OutputSink::STREAM;
+    _user_stream = std::move(stream);
+    _buffer_callback = nullptr;
+    _output_pipe = "";
+    _close_user_stream = false;
+}
 
-    if (!_schema) {
-        throw parquetwriter::writer_exception("Empty Parquet schema");
+void Writer::set_output_pipe(const std::string& path) {
+    if (path.empty()) {
+        throw parquetwriter::writer_exception(
+            "Empty output pipe path provided");
     }
+    _output_sink = OutputSink::STREAM;
+    _user_stream = nullptr;
+    _buffer_callback = nullptr;
+    _output_pipe = path;
+    _close_user_stream = true;
+}
 
-    if (_columns.size() == 0) {
-        throw parquetwriter::writer_exception("Empty file layout (no columns)");
+void Writer::set_output_callback(
+    const streams::CallbackOutputStream::Callback& callback) {
+    if (!callback) {
+        throw parquetwriter::writer_exception("Null output callback provided");
     }
+    _output_sink = OutputSink::STREAM;
+    _user_stream = std::make_shared<streams::CallbackOutputStream>(callback);
+    _buffer_callback = nullptr;
+    _output_pipe = "";
+    _close_user_stream = true;
+}
 
-    //
-    // create the output path and filesystem handler
-    //
-    std::string internal_path;
-    _fs = arrow::fs::FileSystemFromUriOrPath(
-              std::filesystem::absolute(_output_directory), &internal_path)
-              .ValueOrDie();
-    PARQUET_THROW_NOT_OK(_fs->CreateDir(internal_path));
-    _internal_fs =
-        std::make_shared<arrow::fs::SubTreeFileSystem>(internal_path, _fs);
-
-    // create the output stream at the new location
-    update_output_stream();
-
-    //
-    // default RowGroup specification for now (need to make configurable)
-    //
-    if (_n_rows_in_group < 0) {
-        _n_rows_in_group = 250000 / _expected_fields_to_fill.size();
+void Writer::set_max_open_partitions(const uint32_t& n) {
+    if (n == 0) {
+        throw parquetwriter::writer_exception(
+            "The maximum number of open partition files must be non-zero");
     }
+    _max_open_partitions = n;
+}
 
-    //
-    // create the Parquet writer instance
-    //
-
-    auto compression = arrow::Compression::UNCOMPRESSED;
-    switch (_compression) {
-        case Compression::UNCOMPRESSED: {
-            compression = arrow::Compression::UNCOMPRESSED;
-            break;
-        }
-        case Compression::GZIP: {
-            compression = arrow::Compression::GZIP;
-            break;
-        }
-        case Compression::SNAPPY: {
-            compression = arrow::Compression::SNAPPY;
-            break;
-        }
-    };
-
-    auto writer_properties = parquet::WriterProperties::Builder()
-                                 .compression(compression)
-                                 ->data_pagesize(_data_pagesize)
-                                 ->build();
+void Writer::set_rotation_rule(const RotationRule& rule, const uint64_t& n) {
+    if (rule != RotationRule::NONE && n == 0) {
+        throw parquetwriter::writer_exception(
+            "Rotation rule " + rotationrule2str(rule) +
+            " requires a non-zero limit");
+    }
+    _rotation_rule = rule;
+    _rotation_n = n;
+}
 
-    auto arrow_writer_properties =
-        parquet::ArrowWriterProperties::Builder().store_schema()->build();
-    PARQUET_THROW_NOT_OK(parquet::arrow::FileWriter::Open(
-        *_schema, arrow::default_memory_pool(), _output_stream,
-        writer_properties, arrow_writer_properties, &_file_writer));
+void Writer::set_durability(const Durability& durability, const uint32_t& n) {
+    if (durability != Durability::NONE && n == 0) {
+        throw parquetwriter::writer_exception(
+            "Durability policy " + durability2str(durability) +
+            " requires a non-zero RowGroup count or interval");
+    }
+    _durability = durability;
+    _durability_n = n;
 }
 
 void Writer::set_flush_rule(const FlushRule& rule, const uint32_t& n) {
@@ -281,7 +1564,7 @@ void Writer::fill_value(const std::string& field_name,
     std::visit(internal::DataValueFillVisitor(field_name, builder), input_data);
 }
 
-void Writer::fill(const std::string& field_path, const value_t& data_value) {
+arrow::ArrayBuilder* Writer::value_builder(const std::string& field_path) {
     auto field_fill_type = _expected_fields_filltype_map.at(field_path);
     bool matches_expected_column_type =
         field_fill_type == FillType::VALUE ||
@@ -303,15 +1586,194 @@ void Writer::fill(const std::string& field_path, const value_t& data_value) {
             "\" could not be found");
     }
 
-    auto builder = _column_builder_map.at(parent_column_name).at(field_path);
+    return _column_builder_map.at(parent_column_name).at(field_path);
+}
+
+void Writer::fill(const std::string& field_path, const value_t& data_value) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, internal::offset_growth(data_value));
+    }
+    auto builder = this->value_builder(field_path);
     this->fill_value(field_path, builder, data_value);
 
     // signal end of fill
     end_fill(field_path);
 }
 
+void Writer::fill(const std::string& field_path, std::string_view data_value) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, data_value.size());
+    }
+    auto builder = this->value_builder(field_path);
+    internal::throw_for_invalid_binary_type(field_path, builder, 0);
+    internal::binary_append(field_path, builder, data_value);
+
+    // signal end of fill
+    end_fill(field_path);
+}
+
+void Writer::fill(const std::string& field_path,
+                  const std::vector<std::string_view>& data_values) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, internal::offset_growth(data_values));
+    }
+    auto builder = this->value_builder(field_path);
+    internal::throw_for_invalid_binary_type(field_path, builder, 1);
+    PARQUET_THROW_NOT_OK(helpers::list_builder_append(builder));
+    internal::binary_append_values(
+        field_path, helpers::list_value_builder(builder), data_values);
+
+    // signal end of fill
+    end_fill(field_path);
+}
+
+void Writer::fill_map(const std::string& field_path, const void* keys,
+                      const std::shared_ptr<arrow::DataType>& key_type,
+                      size_t n_keys, const void* values,
+                      const std::shared_ptr<arrow::DataType>& value_type,
+                      size_t n_values) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, n_keys + n_values);
+    }
+    auto builder = this->value_builder(field_path);
+    auto map_builder = dynamic_cast<arrow::MapBuilder*>(builder);
+    if (!map_builder ||
+        helpers::fill_type_id(map_builder->key_builder()->type()->id()) !=
+            key_type->id() ||
+        helpers::fill_type_id(map_builder->item_builder()->type()->id()) !=
+            value_type->id()) {
+        throw parquetwriter::data_type_exception(
+            "Invalid data type provided for column/field \"" + field_path +
+            "\", expect: \"" + builder->type()->ToString() +
+            "\", got: \"map<" + key_type->name() + ", " + value_type->name() +
+            ">\"");
+    }
+    if (n_keys != n_values) {
+        throw parquetwriter::data_type_exception(
+            "Invalid map entry provided for column/field \"" + field_path +
+            "\", got " + std::to_string(n_keys) + " keys but " +
+            std::to_string(n_values) + " values");
+    }
+
+    // one offset for the entry, the keys and values go straight into their
+    // builders
+    PARQUET_THROW_NOT_OK(map_builder->Append());
+    internal::append_typed_values(field_path, map_builder->key_builder(), keys,
+                                  key_type->id(), n_keys);
+    internal::append_typed_values(field_path, map_builder->item_builder(),
+                                  values, value_type->id(), n_values);
+
+    // signal end of fill
+    end_fill(field_path);
+}
+
+void Writer::fill_ticks(const std::string& field_path, int64_t ticks,
+                        intmax_t num, intmax_t den) {
+    auto builder = this->value_builder(field_path);
+    auto type = builder->type();
+
+    // the seconds per tick of the column (as column_num / column_den)
+    int64_t column_num = 1;
+    int64_t column_den = 1;
+    std::optional<arrow::TimeUnit::type> unit;
+    if (type->id() == arrow::Type::TIMESTAMP) {
+        unit = static_cast<const arrow::TimestampType&>(*type).unit();
+    } else if (type->id() == arrow::Type::DURATION) {
+        unit = static_cast<const arrow::DurationType&>(*type).unit();
+    } else if (type->id() == arrow::Type::DATE32) {
+        column_num = 86400;
+    } else {
+        throw parquetwriter::data_type_exception(
+            "Invalid data type provided for column/field \"" + field_path +
+            "\", expect: \"" + type->ToString() +
+            "\", got: \"std::chrono\" value");
+    }
+    if (unit) {
+        switch (*unit) {
+            case arrow::TimeUnit::SECOND:
+                break;
+            case arrow::TimeUnit::MILLI:
+                column_den = 1000;
+                break;
+            case arrow::TimeUnit::MICRO:
+                column_den = 1000000;
+                break;
+            case arrow::TimeUnit::NANO:
+                column_den = 1000000000;
+                break;
+        }
+    }
+
+    // rescale, rounding down like std::chrono::floor so that times before
+    // the epoch fall on the right day, and failing rather than wrapping
+    // around for times beyond the range of the column
+    int64_t scale_num = 0;
+    int64_t scale_den = 0;
+    int64_t scaled = 0;
+    bool overflow = __builtin_mul_overflow(num, column_den, &scale_num) ||
+                    __builtin_mul_overflow(den, column_num, &scale_den);
+    if (!overflow) {
+        int64_t divisor = std::gcd(scale_num, scale_den);
+        scale_num /= divisor;
+        scale_den /= divisor;
+        overflow = __builtin_mul_overflow(ticks, scale_num, &scaled);
+    }
+    int64_t value = overflow ? 0 : scaled / scale_den;
+    if (!overflow && scaled % scale_den != 0 && scaled < 0) {
+        value--;
+    }
+    if (type->id() == arrow::Type::DATE32) {
+        overflow = overflow || value < std::numeric_limits<int32_t>::min() ||
+                   value > std::numeric_limits<int32_t>::max();
+    }
+    if (overflow) {
+        throw parquetwriter::data_type_exception(
+            "Value provided for column/field \"" + field_path +
+            "\" overflows when converted to the unit of the column (\"" +
+            type->ToString() + "\")");
+    }
+
+    if (type->id() == arrow::Type::DATE32) {
+        this->fill(field_path, value_t(static_cast<int32_t>(value)));
+    } else {
+        this->fill(field_path, value_t(value));
+    }
+}
+
+template <typename T>
+void Writer::fill(const std::string& field_path, const T* data_values,
+                  size_t n) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, n);
+    }
+    auto builder = this->value_builder(field_path);
+    if (builder->type()->id() == arrow::Type::FIXED_SIZE_LIST) {
+        internal::fixed_list_append(field_path, builder, data_values, n);
+    } else {
+        internal::list_append(field_path, builder, data_values, n);
+    }
+
+    // signal end of fill
+    end_fill(field_path);
+}
+
+template void Writer::fill(const std::string&, const uint8_t*, size_t);
+template void Writer::fill(const std::string&, const uint16_t*, size_t);
+template void Writer::fill(const std::string&, const uint32_t*, size_t);
+template void Writer::fill(const std::string&, const uint64_t*, size_t);
+template void Writer::fill(const std::string&, const int8_t*, size_t);
+template void Writer::fill(const std::string&, const int16_t*, size_t);
+template void Writer::fill(const std::string&, const int32_t*, size_t);
+template void Writer::fill(const std::string&, const int64_t*, size_t);
+template void Writer::fill(const std::string&, const float*, size_t);
+template void Writer::fill(const std::string&, const double*, size_t);
+
 void Writer::fill(const std::string& field_path,
                   const struct_buffer_t& struct_buffer_data) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch,
+                              internal::offset_growth(struct_buffer_data));
+    }
     auto StructFillVisitor = [&](const auto& t) {
         this->fill_struct_type(field_path, t);
     };
@@ -323,6 +1785,9 @@ void Writer::fill(const std::string& field_path,
 
 void Writer::fill(const std::string& field_path,
                   const struct_map_t& struct_map_data) {
+    if (auto watch = this->offset_watch(field_path)) {
+        this->reserve_offsets(*watch, internal::offset_growth(struct_map_data));
+    }
     auto StructFillVisitor = [&](const auto& t) {
         this->fill_struct_type(field_path, t);
     };
@@ -664,11 +2129,115 @@ bool Writer::row_is_complete() {
 }
 
 void Writer::flush_if_ready() {
-    if (_n_current_rows_filled % _n_rows_in_group == 0) {
+    if (_n_current_rows_filled % _n_rows_in_group == 0 ||
+        this->offsets_near_limit()) {
         this->flush();
     }
 }
 
+bool Writer::offsets_near_limit() {
+    // the RowGroup is flushed early if another row as large as the largest
+    // one seen so far could take the 32-bit offsets past the limit, the
+    // builders only being measured once the upper bound on their offsets
+    // gets there
+    constexpr int64_t max_offset = std::numeric_limits<int32_t>::max() - 1;
+    bool near_limit = false;
+    for (auto& watch : _offset_watches) {
+        watch.max_row_growth = std::max(watch.max_row_growth, watch.row_growth);
+        watch.row_growth = 0;
+        if (watch.offset + watch.added + watch.max_row_growth <= max_offset) {
+            continue;
+        }
+        watch.offset = helpers::max_int32_offset(watch.builder);
+        watch.added = 0;
+        if (watch.offset + watch.max_row_growth > max_offset) {
+            log->debug(
+                "{0} - Flushing RowGroup of {1} rows early, the offsets of "
+                "column \"{2}\" are near their limit",
+                __PRETTYFUNCTION__, _n_current_rows_filled, watch.column_name);
+            near_limit = true;
+        }
+    }
+    return near_limit;
+}
+
+Writer::OffsetWatch* Writer::offset_watch(const std::string& field_path) {
+    auto index = _offset_watch_index.find(field_path);
+    if (index == _offset_watch_index.end()) return nullptr;
+    return &_offset_watches.at(index->second);
+}
+
+void Writer::reserve_offsets(OffsetWatch& watch, int64_t growth) {
+    // a row larger than any before it cannot be caught by the check after
+    // each row, so each value is checked before it is appended (and the
+    // builder measured once the upper bound on its offsets gets there)
+    constexpr int64_t max_offset = std::numeric_limits<int32_t>::max() - 1;
+    if (watch.offset + watch.added + growth > max_offset) {
+        watch.offset = helpers::max_int32_offset(watch.builder);
+        watch.added = 0;
+        if (watch.offset + growth > max_offset && _n_current_rows_filled > 0) {
+            log->debug(
+                "{0} - Flushing RowGroup of {1} rows early, the next value of "
+                "column \"{2}\" would overflow its offsets",
+                __PRETTYFUNCTION__, _n_current_rows_filled, watch.column_name);
+            this->flush_complete_rows();
+        }
+        if (watch.offset + growth > max_offset) {
+            throw parquetwriter::writer_exception(
+                "Column \"" + watch.column_name +
+                "\" cannot hold the values (or bytes) of a single row with its "
+                "32-bit offsets, use \"large\" list or "
+                "large_string/large_binary types for it");
+        }
+    }
+    watch.added += growth;
+    watch.row_growth += growth;
+}
+
+void Writer::flush_complete_rows() {
+    // the columns already filled for the row in progress hold one more
+    // value than there are complete rows, which is split off of them
+    std::map<std::string, std::shared_ptr<arrow::Array>> row_values;
+    for (const auto& column : _columns) {
+        const auto& name = column->name();
+        auto builder = _column_builder_map.at(name).at(name);
+        if (builder->length() == _n_current_rows_filled) continue;
+
+        // a struct column whose nested structs are still to be filled does
+        // not hold a whole value of the row yet
+        for (const auto& [field, count] : _expected_field_fill_map) {
+            if (helpers::parent_column_name_from_field(field) == name &&
+                count != _expected_field_fill_map.at(name)) {
+                throw parquetwriter::writer_exception(
+                    "Cannot flush the RowGroup early while struct column \"" +
+                    name + "\" is partially filled, fill it after the columns "
+                    "holding the largest values of the row");
+            }
+        }
+
+        std::shared_ptr<arrow::Array> array;
+        PARQUET_THROW_NOT_OK(builder->Finish(&array));
+        row_values[name] = array->Slice(_n_current_rows_filled);
+        _finished_columns[name] =
+            this->stored_array(name, array->Slice(0, _n_current_rows_filled));
+    }
+
+    this->flush();
+
+    // the values of the row in progress lead the next RowGroup
+    for (const auto& [name, values] : row_values) {
+        auto builder = _column_builder_map.at(name).at(name);
+        for (int64_t i = 0; i < values->length(); i++) {
+            std::shared_ptr<arrow::Scalar> scalar;
+            PARQUET_ASSIGN_OR_THROW(scalar, values->GetScalar(i));
+            PARQUET_THROW_NOT_OK(builder->AppendScalar(*scalar));
+        }
+    }
+    for (auto& watch : _offset_watches) {
+        watch.offset = helpers::max_int32_offset(watch.builder);
+    }
+}
+
 void Writer::append_empty_value(const std::string& field_path) {
     arrow::ArrayBuilder* builder = nullptr;
     size_t pos_parent = field_path.find_first_of("/.");
@@ -711,13 +2280,13 @@ void Writer::append_empty_value(const std::string& field_path) {
 
     // nested types (list, struct)
     bool is_struct = builder_type->id() == arrow::Type::STRUCT;
-    bool is_list = builder_type->id() == arrow::Type::LIST;
+    bool is_list = helpers::is_list_type(builder_type->id());
     bool is_nested = is_struct || is_list;
     if (!is_nested) {
         PARQUET_THROW_NOT_OK(builder->AppendEmptyValue());
     } else if (is_list) {
-        auto list_builder = dynamic_cast<arrow::ListBuilder*>(builder);
-        PARQUET_THROW_NOT_OK(list_builder->AppendEmptyValue());
+        // (either a list or a large_list builder)
+        PARQUET_THROW_NOT_OK(builder->AppendEmptyValue());
     } else if (is_struct) {
         auto struct_builder = dynamic_cast<arrow::StructBuilder*>(builder);
         PARQUET_THROW_NOT_OK(struct_builder->AppendEmptyValue());
@@ -762,13 +2331,13 @@ void Writer::append_null_value(const std::string& field_path) {
 
     // nested types (list, struct)
     bool is_struct = builder_type->id() == arrow::Type::STRUCT;
-    bool is_list = builder_type->id() == arrow::Type::LIST;
+    bool is_list = helpers::is_list_type(builder_type->id());
     bool is_nested = is_struct || is_list;
     if (!is_nested) {
         PARQUET_THROW_NOT_OK(builder->AppendNull());
     } else if (is_list) {
-        auto list_builder = dynamic_cast<arrow::ListBuilder*>(builder);
-        PARQUET_THROW_NOT_OK(list_builder->AppendNull());
+        // (either a list or a large_list builder)
+        PARQUET_THROW_NOT_OK(builder->AppendNull());
     } else if (is_struct) {
         auto struct_builder = dynamic_cast<arrow::StructBuilder*>(builder);
         PARQUET_THROW_NOT_OK(struct_builder->AppendNull());
@@ -804,28 +2373,508 @@ void Writer::end_row() {
 }
 
 void Writer::flush() {
-    _arrays.clear();
-    std::shared_ptr<arrow::Array> array;
-    for (auto& column : _columns) {
-        PARQUET_THROW_NOT_OK(_column_builder_map.at(column->name())
-                                 .at(column->name())
-                                 ->Finish(&array));
-        _arrays.push_back(array);
+    // the partition columns are finished up front since they decide which
+    // output file each of the rows goes to (the columns finished by
+    // flush_complete_rows are taken as they are)
+    std::map<std::string, std::shared_ptr<arrow::Array>> finished;
+    finished.swap(_finished_columns);
+    for (const auto& partition_column : _partition_columns) {
+        if (finished.count(partition_column)) continue;
+        finished[partition_column] = this->finish_column(partition_column);
+    }
+    auto partitions = this->partition_rows(finished);
+
+    // as are the sort columns, which decide the order of the rows within
+    // each partition
+    int64_t sort_bytes = 0;
+    if (!_sort_columns.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& sort_column : _sort_columns) {
+            if (finished.count(sort_column)) continue;
+            finished[sort_column] = this->finish_column(sort_column);
+        }
+        sort_bytes = this->sort_rows(finished, partitions);
+        _stats.sort_seconds += std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
     }
 
-    auto table = arrow::Table::Make(_schema, _arrays);
-    PARQUET_THROW_NOT_OK(
-        _file_writer->WriteTable(*table, _n_current_rows_filled));
+    // the compression is chosen on the first RowGroup, before any of the
+    // output files are opened, so all of the columns are finished here
+    if (_tune_compression && !_compression_tuned) {
+        for (const auto& column : _columns) {
+            if (finished.count(column->name())) continue;
+            finished[column->name()] = this->finish_column(column->name());
+        }
+        this->tune_compression(finished);
+    }
+
+    // the index of each row in the dataset, stored in every shard so that
+    // the shards can be zipped back together
+    if (_shard_schemas.size() > 1) {
+        arrow::Int64Builder row_index_builder;
+        PARQUET_THROW_NOT_OK(row_index_builder.Reserve(_n_current_rows_filled));
+        for (uint32_t irow = 0; irow < _n_current_rows_filled; irow++) {
+            row_index_builder.UnsafeAppend(_stats.rows_written + irow);
+        }
+        PARQUET_THROW_NOT_OK(
+            row_index_builder.Finish(&finished[ROW_INDEX_COLUMN]));
+    }
+
+    // the output files are opened (or waited for) before handing them over
+    // to the shard writers
+    std::vector<std::vector<OutputFile>*> outputs;
+    for (const auto& partition : partitions) {
+        outputs.push_back(&this->output(partition.partition));
+    }
+
+    auto flush_shard = [&](size_t shard) -> int64_t {
+        switch (_write_mode) {
+            case WriteMode::TABLE: {
+                return this->flush_table(shard, partitions, outputs, finished);
+            }
+            case WriteMode::STREAM: {
+                return this->flush_stream(shard, partitions, outputs,
+                                          finished);
+            }
+        }
+        return 0;
+    };
+
+    // each shard holds its own set of columns (and so of builders), so the
+    // shards can be encoded and written concurrently
+    int64_t reordered_bytes = 0;
+    if (_shard_schemas.size() == 1) {
+        reordered_bytes = flush_shard(0);
+    } else {
+        std::vector<std::future<int64_t>> shard_flushes;
+        for (size_t shard = 0; shard < _shard_schemas.size(); shard++) {
+            shard_flushes.push_back(
+                std::async(std::launch::async, flush_shard, shard));
+        }
+        for (auto& shard_flush : shard_flushes) {
+            shard_flush.wait();
+        }
+        for (auto& shard_flush : shard_flushes) {
+            reordered_bytes += shard_flush.get();
+        }
+    }
+    if (!_sort_columns.empty()) {
+        _stats.sort_peak_bytes =
+            std::max<uint64_t>(_stats.sort_peak_bytes,
+                               sort_bytes + reordered_bytes);
+    }
+    _stats.rows_written += _n_current_rows_filled;
+    _stats.row_groups_written++;
     _n_current_rows_filled = 0;
+    for (auto& watch : _offset_watches) {
+        watch.offset = 0;
+        watch.added = 0;
+    }
+
+    for (size_t ipartition = 0; ipartition < partitions.size(); ipartition++) {
+        for (auto& output : *outputs.at(ipartition)) {
+            output.n_rows += partitions.at(ipartition).n_rows;
+            output.last_row_group = _stats.row_groups_written;
 
-    // flush to the output file
-    PARQUET_THROW_NOT_OK(_output_stream->Flush());
-    _arrays.clear();
+            // push the RowGroup out to the output file
+            this->sync_output(output, false, _stats);
+        }
+    }
+
+    // all shards of a partition move on to new files together, so that they
+    // keep holding the same rows
+    for (size_t ipartition = 0; ipartition < partitions.size(); ipartition++) {
+        if (this->rotation_due(*outputs.at(ipartition))) {
+            this->new_file(partitions.at(ipartition).partition);
+        }
+    }
+    this->close_stale_partitions();
 }
 
-void Writer::finish() {
-    this->flush();
-    PARQUET_THROW_NOT_OK(_file_writer->Close());
+std::vector<Writer::PartitionRows> Writer::partition_rows(
+    const std::map<std::string, std::shared_ptr<arrow::Array>>&
+        partition_arrays) const {
+    if (_partition_columns.empty()) {
+        return {PartitionRows{"", nullptr, _n_current_rows_filled}};
+    }
+
+    // dictionary-encode the partition columns so that the rows can be
+    // grouped on small integer codes, and so that each distinct value is
+    // only formatted once
+    size_t n_columns = _partition_columns.size();
+    std::vector<std::shared_ptr<arrow::Array>> codes(n_columns);
+    std::vector<std::vector<std::string>> directories(n_columns);
+    for (size_t icol = 0; icol < n_columns; icol++) {
+        const auto& name = _partition_columns.at(icol);
+        const auto& array = partition_arrays.at(name);
+        std::shared_ptr<arrow::DictionaryArray> dict_array;
+        if (array->type_id() == arrow::Type::DICTIONARY) {
+            // dictionary type columns are already encoded (with int32 indices)
+            dict_array = std::static_pointer_cast<arrow::DictionaryArray>(array);
+        } else {
+            arrow::Datum encoded;
+            PARQUET_ASSIGN_OR_THROW(encoded,
+                                    arrow::compute::DictionaryEncode(array));
+            dict_array = std::static_pointer_cast<arrow::DictionaryArray>(
+                encoded.make_array());
+        }
+        codes.at(icol) = dict_array->indices();
+
+        auto dictionary = dict_array->dictionary();
+        for (int64_t i = 0; i < dictionary->length(); i++) {
+            std::shared_ptr<arrow::Scalar> value;
+            PARQUET_ASSIGN_OR_THROW(value, dictionary->GetScalar(i));
+            directories.at(icol).push_back(
+                name + "=" + helpers::hive_partition_value(value->ToString()));
+        }
+        // nulls get the last code
+        directories.at(icol).push_back(name + "=__HIVE_DEFAULT_PARTITION__");
+    }
+
+    // combine the per-column codes into one code per row
+    std::map<int64_t, std::vector<int64_t>> rows_by_code;
+    for (int64_t irow = 0; irow < _n_current_rows_filled; irow++) {
+        int64_t code = 0;
+        for (size_t icol = 0; icol < n_columns; icol++) {
+            const auto& column_codes =
+                static_cast<const arrow::Int32Array&>(*codes.at(icol));
+            int64_t n_codes = directories.at(icol).size();
+            int64_t column_code = column_codes.IsNull(irow)
+                                      ? n_codes - 1
+                                      : column_codes.Value(irow);
+            code = code * n_codes + column_code;
+        }
+        rows_by_code[code].push_back(irow);
+    }
+
+    std::vector<PartitionRows> out;
+    for (const auto& [code, rows] : rows_by_code) {
+        // recover the per-column codes to name the partition directory
+        std::vector<std::string> path(n_columns);
+        int64_t remainder = code;
+        for (size_t icol = n_columns; icol-- > 0;) {
+            int64_t n_codes = directories.at(icol).size();
+            path.at(icol) = directories.at(icol).at(remainder % n_codes);
+            remainder /= n_codes;
+        }
+        std::stringstream partition;
+        for (size_t icol = 0; icol < n_columns; icol++) {
+            partition << (icol > 0 ? "/" : "") << path.at(icol);
+        }
+
+        std::shared_ptr<arrow::Array> row_indices = nullptr;
+        if (rows_by_code.size() > 1) {
+            arrow::Int64Builder indices_builder;
+            PARQUET_THROW_NOT_OK(indices_builder.AppendValues(rows));
+            PARQUET_THROW_NOT_OK(indices_builder.Finish(&row_indices));
+        }
+        out.push_back(PartitionRows{partition.str(), row_indices,
+                                    static_cast<int64_t>(rows.size())});
+    }
+    return out;
+}
+
+std::shared_ptr<arrow::Array> Writer::finish_column(
+    const std::string& column_name) const {
+    std::shared_ptr<arrow::Array> array;
+    PARQUET_THROW_NOT_OK(
+        _column_builder_map.at(column_name).at(column_name)->Finish(&array));
+    return this->stored_array(column_name, array);
+}
+
+std::shared_ptr<arrow::Array> Writer::stored_array(
+    const std::string& column_name,
+    std::shared_ptr<arrow::Array> array) const {
+    // drop the requested low mantissa bits of the floating point values,
+    // a whole buffer at a time, before the column is encoded
+    if (!_keep_mantissa_bits.empty()) {
+        helpers::truncate_mantissas(array->data(), column_name,
+                                    _keep_mantissa_bits);
+    }
+
+    // the array as written out, see storage_field
+    auto storage_data = helpers::storage_array_data(array->data());
+    if (storage_data != array->data()) {
+        array = arrow::MakeArray(storage_data);
+    }
+    return array;
+}
+
+int64_t Writer::sort_rows(
+    const std::map<std::string, std::shared_ptr<arrow::Array>>& finished,
+    std::vector<PartitionRows>& partitions) const {
+    std::vector<std::shared_ptr<arrow::Field>> sort_fields;
+    std::vector<std::shared_ptr<arrow::Array>> sort_arrays;
+    std::vector<arrow::compute::SortKey> sort_keys;
+    for (const auto& sort_column : _sort_columns) {
+        sort_fields.push_back(_schema->GetFieldByName(sort_column));
+        sort_arrays.push_back(finished.at(sort_column));
+        sort_keys.emplace_back(sort_column);
+    }
+    auto sort_schema = arrow::schema(sort_fields);
+    arrow::compute::SortOptions sort_options(sort_keys);
+
+    // the ordering of the rows of a partition is given in terms of the rows
+    // of the partition, and so picks from the partition's row indices
+    int64_t n_bytes = 0;
+    for (auto& partition : partitions) {
+        auto partition_arrays = sort_arrays;
+        if (partition.row_indices) {
+            for (auto& partition_array : partition_arrays) {
+                PARQUET_ASSIGN_OR_THROW(
+                    partition_array,
+                    arrow::compute::Take(*partition_array,
+                                         *partition.row_indices));
+            }
+        }
+        auto batch = arrow::RecordBatch::Make(sort_schema, partition.n_rows,
+                                              partition_arrays);
+
+        std::shared_ptr<arrow::Array> sort_indices;
+        PARQUET_ASSIGN_OR_THROW(
+            sort_indices,
+            arrow::compute::SortIndices(arrow::Datum(batch), sort_options));
+        if (partition.row_indices) {
+            PARQUET_ASSIGN_OR_THROW(
+                partition.row_indices,
+                arrow::compute::Take(*partition.row_indices, *sort_indices));
+        } else {
+            partition.row_indices = sort_indices;
+        }
+        n_bytes += helpers::array_data_size(partition.row_indices->data());
+    }
+    return n_bytes;
+}
+
+bool Writer::column_in_files(const std::string& column_name) const {
+    if (!_drop_partition_columns) return true;
+    return std::find(_partition_columns.begin(), _partition_columns.end(),
+                     column_name) == _partition_columns.end();
+}
+
+void Writer::sync_output(OutputFile& output, bool force,
+                         WriterStats& stats) const {
+    bool do_flush = force;
+    bool do_fsync = false;
+    output.n_row_groups_since_sync++;
+    switch (_durability) {
+        case Durability::NONE: {
+            break;
+        }
+        case Durability::FLUSH: {
+            do_flush =
+                do_flush || output.n_row_groups_since_sync >= _durability_n;
+            break;
+        }
+        case Durability::FSYNC: {
+            auto elapsed =
+                std::chrono::steady_clock::now() - output.last_sync_time;
+            do_fsync = force || elapsed >= std::chrono::seconds(_durability_n);
+            do_flush = do_flush || do_fsync;
+            break;
+        }
+    }
+
+    // the RowGroup has to reach the file for its pages to be released
+    do_flush = do_flush || _release_page_cache;
+
+    // the io_uring stream hands each of its buffers over as soon as it is
+    // full, whereas flushing it waits for all of the writes in flight and
+    // writes out the partial buffer synchronously, so it is only flushed
+    // when the file is synced or closed
+    if (_io_backend == IOBackend::URING && !do_fsync && !force) {
+        do_flush = false;
+    }
+
+    if (do_flush) {
+        PARQUET_THROW_NOT_OK(output.stream->Flush());
+        stats.n_flushes++;
+        output.n_row_groups_since_sync = 0;
+    }
+
+    int fd = streams::file_descriptor(output.file_stream);
+    if (do_fsync && fd >= 0) {
+        auto start = std::chrono::steady_clock::now();
+        streams::fsync(fd);
+        output.last_sync_time = std::chrono::steady_clock::now();
+        stats.n_fsyncs++;
+        stats.fsync_seconds +=
+            std::chrono::duration<double>(output.last_sync_time - start)
+                .count();
+    }
+
+    if (_release_page_cache) {
+        this->release_page_cache(output, false);
+    }
+}
+
+void Writer::release_page_cache(OutputFile& output, bool all) const {
+    int fd = streams::file_descriptor(output.file_stream);
+    if (fd < 0) return;
+
+    // waiting on the writeback of the previous range rather than of the
+    // range just written keeps the disk busy without stalling the writer
+    int64_t written = output.file_stream->n_bytes();
+    // bytes still queued for io_uring are not in the page cache yet
+    if (auto uring = std::dynamic_pointer_cast<streams::UringOutputStream>(
+            output.file_stream->raw())) {
+        written = std::min(written, uring->completed_bytes());
+    }
+    int64_t release_end = all ? written : output.writeback_offset;
+    streams::release_range(fd, output.released_offset,
+                           release_end - output.released_offset);
+    output.released_offset = release_end;
+
+    if (!all) {
+        streams::start_writeback(fd, output.writeback_offset,
+                                 written - output.writeback_offset);
+    }
+    output.writeback_offset = written;
+}
+
+WriterStats Writer::stats() {
+    // pick up the counts of the previous output files that have been closed
+    this->collect_closed(false);
+
+    WriterStats stats = _stats;
+    for (const auto& [partition, outputs] : _outputs) {
+        for (const auto& output : outputs) {
+            stats.bytes_written += output.file_stream->n_bytes();
+            stats.n_writes += output.file_stream->n_writes();
+        }
+    }
+    return stats;
+}
+
+int64_t Writer::flush_table(
+    size_t shard, const std::vector<PartitionRows>& partitions,
+    const std::vector<std::vector<OutputFile>*>& outputs,
+    const std::map<std::string, std::shared_ptr<arrow::Array>>& finished) {
+    std::vector<std::shared_ptr<arrow::Array>> arrays;
+    for (const auto& column_name : _shard_columns.at(shard)) {
+        auto array = finished.count(column_name)
+                         ? finished.at(column_name)
+                         : this->finish_column(column_name);
+        arrays.push_back(array);
+    }
+
+    int64_t reordered_bytes = 0;
+    for (size_t ipartition = 0; ipartition < partitions.size(); ipartition++) {
+        const auto& partition = partitions.at(ipartition);
+        auto partition_arrays = arrays;
+        if (partition.row_indices) {
+            int64_t partition_bytes = 0;
+            for (auto& partition_array : partition_arrays) {
+                PARQUET_ASSIGN_OR_THROW(
+                    partition_array,
+                    arrow::compute::Take(*partition_array,
+                                         *partition.row_indices));
+                partition_bytes +=
+                    helpers::array_data_size(partition_array->data());
+            }
+            reordered_bytes = std::max(reordered_bytes, partition_bytes);
+        }
+        auto table = arrow::Table::Make(_shard_schemas.at(shard),
+                                        partition_arrays, partition.n_rows);
+        PARQUET_THROW_NOT_OK(
+            outputs.at(ipartition)
+                ->at(shard)
+                .file_writer->WriteTable(*table, partition.n_rows));
+    }
+    return reordered_bytes;
+}
+
+int64_t Writer::flush_stream(
+    size_t shard, const std::vector<PartitionRows>& partitions,
+    const std::vector<std::vector<OutputFile>*>& outputs,
+    const std::map<std::string, std::shared_ptr<arrow::Array>>& finished) {
+    // open the RowGroup up front and hand each column over as soon as its
+    // builder is finished, so that at most one finished column (plus its
+    // encoded pages) is held in memory alongside the unfinished builders
+    for (size_t ipartition = 0; ipartition < partitions.size(); ipartition++) {
+        PARQUET_THROW_NOT_OK(
+            outputs.at(ipartition)
+                ->at(shard)
+                .file_writer->NewRowGroup(partitions.at(ipartition).n_rows));
+    }
+
+    int64_t reordered_bytes = 0;
+    for (const auto& column_name : _shard_columns.at(shard)) {
+        auto array = finished.count(column_name)
+                         ? finished.at(column_name)
+                         : this->finish_column(column_name);
+
+        for (size_t ipartition = 0; ipartition < partitions.size();
+             ipartition++) {
+            const auto& partition = partitions.at(ipartition);
+            auto partition_array = array;
+            if (partition.row_indices) {
+                PARQUET_ASSIGN_OR_THROW(
+                    partition_array,
+                    arrow::compute::Take(*array, *partition.row_indices));
+                reordered_bytes = std::max(
+                    reordered_bytes,
+                    helpers::array_data_size(partition_array->data()));
+            }
+            PARQUET_THROW_NOT_OK(outputs.at(ipartition)
+                                     ->at(shard)
+                                     .file_writer->WriteColumnChunk(
+                                         *partition_array));
+        }
+    }
+    return reordered_bytes;
+}
+
+std::shared_ptr<arrow::Buffer> Writer::finish() {
+    std::shared_ptr<arrow::Buffer> last_buffer = nullptr;
+    if (_n_current_rows_filled > 0) {
+        this->flush();
+    }
+
+    // an (empty) output file is still written if no rows were
+    if (_partition_columns.empty() && _file_counts.empty()) {
+        this->output();
+    }
+
+    // pick up the files that are still being opened or closed
+    std::vector<std::string> pending_partitions;
+    for (const auto& [partition, pending_outputs] : _pending_outputs) {
+        pending_partitions.push_back(partition);
+    }
+    for (const auto& partition : pending_partitions) {
+        this->output(partition);
+    }
+    this->collect_closed(true);
+
+    for (auto& [partition, outputs] : _outputs) {
+        for (auto& output : outputs) {
+            // a file that was started by the rotation on the very last
+            // RowGroup does not hold any rows and is dropped
+            bool discard =
+                output.n_rows == 0 && _file_counts.at(partition) > 1;
+            std::string path = output.path;
+
+            std::shared_ptr<arrow::Buffer> buffer;
+            auto closed_stats =
+                this->close_output_file(std::move(output), &buffer);
+            if (discard) {
+                if (_output_sink == OutputSink::FILES) {
+                    PARQUET_THROW_NOT_OK(_internal_fs->DeleteFile(path));
+                }
+                closed_stats.files_written = 0;
+                closed_stats.bytes_written = 0;
+            } else if (buffer) {
+                if (_buffer_callback) {
+                    _buffer_callback(path, buffer);
+                }
+                last_buffer = buffer;
+            }
+            this->add_closed_stats(closed_stats);
+        }
+    }
+    _outputs.clear();
+    return last_buffer;
 }
 
 };  // namespace parquetwriter
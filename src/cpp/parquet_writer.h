@@ -3,15 +3,23 @@
 // parquetwriter
 #include "logging.h"
 #include "parquet_writer_fill_types.h"
+#include "parquet_writer_streams.h"
 #include "parquet_writer_types.h"
 namespace spdlog {
 class logger;
 }
 
 // std/stl
+#include <array>
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // json
@@ -22,6 +30,7 @@ class logger;
 #include <arrow/filesystem/filesystem.h>
 #include <arrow/io/api.h>
 #include <arrow/type.h>
+#include <arrow/util/compression.h>
 #include <parquet/arrow/reader.h>
 #include <parquet/arrow/writer.h>
 #include <parquet/exception.h>
@@ -41,14 +50,65 @@ struct foo {
 
 namespace parquetwriter {
 
-enum class Compression { UNCOMPRESSED, GZIP, SNAPPY };
+enum class Compression { UNCOMPRESSED, GZIP, SNAPPY, ZSTD, LZ4, BROTLI };
 
 enum class FlushRule { NROWS, BUFFERSIZE };
 
+enum class WriteMode { TABLE, STREAM };
+
+enum class Durability { NONE, FLUSH, FSYNC };
+
+enum class RotationRule { NONE, NROWS, NBYTES, NSECONDS };
+
+enum class IOBackend { DEFAULT, URING };
+
+// counters describing what has been written to the output so far
+struct WriterStats {
+    // number of rows, RowGroups, and (closed) files written to the output
+    uint64_t rows_written = 0;
+    uint64_t row_groups_written = 0;
+    uint64_t files_written = 0;
+
+    // number of bytes and write calls that reached the output file(s),
+    // i.e. after any user-space buffering
+    uint64_t bytes_written = 0;
+    uint64_t n_writes = 0;
+
+    // number of explicit stream flushes and fsyncs issued, and the total
+    // time spent in fsync
+    uint64_t n_flushes = 0;
+    uint64_t n_fsyncs = 0;
+    double fsync_seconds = 0;
+
+    // time spent ordering the rows of the RowGroups by the sort columns,
+    // and the largest extra memory that it took at once (the row orderings
+    // plus the reordered copies of the columns)
+    double sort_seconds = 0;
+    uint64_t sort_peak_bytes = 0;
+
+    // number of bloom filters written, and the bytes that they take up in
+    // the output file(s)
+    uint64_t n_bloom_filters = 0;
+    uint64_t bloom_filter_bytes = 0;
+
+    // the compression chosen for each column when tuning the compression
+    // (e.g. "ZSTD(3)"), keyed by column name
+    std::map<std::string, std::string> column_compression;
+
+    // add up the counts of another set of counters (e.g. of a closed output
+    // file), keeping the larger of the peaks
+    WriterStats& operator+=(const WriterStats& other);
+};
+
 class Writer {
  public:
+    // receives each output file written to memory, by name, once finished
+    typedef std::function<void(const std::string&,
+                               std::shared_ptr<arrow::Buffer>)>
+        BufferCallback;
+
     Writer();
-    ~Writer() = default;
+    ~Writer();
 
     // set the name of the output dataset
     void set_dataset_name(const std::string& dataset_name);
@@ -83,29 +143,172 @@ class Writer {
     // metadata provided directly as an instance of nlohmann::json
     void set_metadata(const nlohmann::json& metadata);
 
-    // set the output Parquet file compression algorithm
-    void set_compression(const Compression& compression) {
-        _compression = compression;
-    }
+    // choose the compression of each column (not given one in the layout)
+    // by trial-compressing the first RowGroup (or the given fraction of it)
+    // with each of the candidate algorithms and levels, picking the one with
+    // the best compression ratio among those compressing at no less than
+    // min_throughput MB/s (defaults to a range of SNAPPY, LZ4, ZSTD, GZIP
+    // and BROTLI settings when no candidates are given)
+    void set_compression_tuning(
+        const double& min_throughput, const double& sample_fraction = 1.0,
+        const std::vector<std::pair<Compression, int>>& candidates = {});
+
+    // set the output Parquet file compression algorithm, and optionally its
+    // level (for GZIP, ZSTD and BROTLI); the algorithm and level can be
+    // overridden for individual fields via their "compression" in the layout
+    void set_compression(
+        const Compression& compression,
+        const int& level = arrow::util::kUseDefaultCompressionLevel);
 
     // set the rule governing how the data is flushed to the output file
     void set_flush_rule(const FlushRule& rule, const uint32_t& n);
 
-    // set the Parquet file page size
+    // set whether the min/max statistics of the columns are computed and
+    // written (the default), which can be overridden for individual fields
+    // via their "statistics" in the layout
+    void set_statistics(const bool& statistics) { _statistics = statistics; }
+
+    // set the (uncompressed) size in bytes above which a Parquet data page
+    // is completed, 1 MB by default
     void set_pagesize(const uint32_t& pagesize) { _data_pagesize = pagesize; }
 
+    // set the maximum number of rows in a Parquet data page (0 for the
+    // default of the Arrow library), only available with Arrow versions
+    // supporting it
+    void set_max_rows_per_page(const int64_t& max_rows);
+
+    // set whether the Parquet page index (ColumnIndex and OffsetIndex) is
+    // written, allowing readers to skip the pages within a RowGroup from
+    // their min/max statistics, only available with Arrow versions
+    // supporting it; it can be set for individual fields via their
+    // "page_index" in the layout
+    void set_page_index(const bool& page_index);
+
+    // set how the buffered rows are handed to the Parquet file writer
+    void set_write_mode(const WriteMode& mode) { _write_mode = mode; }
+
+    // set when written RowGroups are pushed out to the output file: never
+    // explicitly (NONE), flush the stream every n RowGroups (FLUSH), or
+    // flush and fsync the file at most every n seconds (FSYNC)
+    void set_durability(const Durability& durability, const uint32_t& n = 1);
+
+    // set the rule for starting a new output file: once the current file
+    // holds n rows (NROWS), n bytes (NBYTES), or has been open for n seconds
+    // (NSECONDS), checked each time a RowGroup is written
+    void set_rotation_rule(const RotationRule& rule, const uint64_t& n);
+
+    // set the maximum number of partition files (see the layout's
+    // "partition_by") kept open at once, beyond which the least recently
+    // written-to ones are closed
+    void set_max_open_partitions(const uint32_t& n);
+
+    // set whether the columns used for partitioning are left out of the
+    // data files (their values are then only given by the directory names)
+    void set_drop_partition_columns(const bool& drop) {
+        _drop_partition_columns = drop;
+    }
+
+    // split the columns of the layout across n files ("shards") that are
+    // encoded and written in parallel, balancing the columns across them by
+    // their estimated size
+    void set_shards(const uint32_t& n);
+
+    // split the columns of the layout across files ("shards") that are
+    // encoded and written in parallel, each given by the names of the
+    // top-level columns that it holds
+    void set_shards(const std::vector<std::vector<std::string>>& shards);
+
+    // set whether the byte range written for each RowGroup is pushed out to
+    // disk and dropped from the page cache, so that the output does not
+    // evict the page cache of other processes
+    void set_release_page_cache(const bool& release) {
+        _release_page_cache = release;
+    }
+
+    // set whether disk space is reserved for each output file when it is
+    // opened, either for size_hint bytes or (if no hint is given) for the
+    // size expected from the rotation rule, so that the files are laid out
+    // contiguously; the files are truncated to their real size when closed
+    void set_preallocation(const bool& preallocate,
+                           const uint64_t& size_hint = 0);
+
+    // write the output file(s) into memory rather than to the output
+    // directory: each finished file is handed over (without copying) to the
+    // callback, if provided, and the last one is also returned by finish()
+    // (the callback is required if rotation, partitioning, or sharding may
+    // produce several files)
+    void set_output_to_buffer(const BufferCallback& callback = nullptr);
+
+    // write the output file to the provided stream rather than to the
+    // output directory (the stream is flushed, but not closed, by finish());
+    // the stream need not be seekable
+    void set_output_stream(std::shared_ptr<arrow::io::OutputStream> stream);
+
+    // write the output file to a pipe: the named pipe (FIFO) at the given
+    // path, or the standard output if the path is "-"
+    void set_output_pipe(const std::string& path);
+
+    // write the output file as a sequence of byte chunks handed to the
+    // callback as they leave the output buffer
+    void set_output_callback(
+        const streams::CallbackOutputStream::Callback& callback);
+
+    // set the size of the user-space buffer sitting in front of the output
+    // file (0 disables the buffering)
+    void set_output_buffer_size(const int64_t& nbytes) {
+        _output_buffer_size = nbytes;
+    }
+
+    // set how the output files are written to: through the Arrow
+    // filesystem's output streams (DEFAULT), or through io_uring with
+    // queue_depth buffers in flight, bypassing the page cache where possible
+    // (URING, falling back to DEFAULT when io_uring is unavailable)
+    void set_io_backend(const IOBackend& backend,
+                        const uint32_t& queue_depth = 4);
+
     // get the set compression algorithm
     const Compression& compression() { return _compression; }
 
     // get the set flush rule
     const FlushRule& flushrule() { return _flush_rule; }
 
+    // get the set write mode
+    const WriteMode& write_mode() { return _write_mode; }
+
+    // get the set durability policy
+    const Durability& durability() { return _durability; }
+
+    // get the set file rotation rule
+    const RotationRule& rotation_rule() { return _rotation_rule; }
+
+    // get the set output I/O backend
+    const IOBackend& io_backend() { return _io_backend; }
+
+    // get the counters describing what has been written so far
+    WriterStats stats();
+
     // get the provided compression algorithm as std::string instance
     static const std::string compression2str(const Compression& compression);
 
+    // get the compression algorithm named by the provided (case-insensitive)
+    // string
+    static Compression str2compression(const std::string& compression);
+
     // get the provided flush rule as a std::string instance
     static const std::string flushrule2str(const FlushRule& flush_rule);
 
+    // get the provided write mode as a std::string instance
+    static const std::string writemode2str(const WriteMode& write_mode);
+
+    // get the provided durability policy as a std::string instance
+    static const std::string durability2str(const Durability& durability);
+
+    // get the provided file rotation rule as a std::string instance
+    static const std::string rotationrule2str(const RotationRule& rule);
+
+    // get the provided output I/O backend as a std::string instance
+    static const std::string iobackend2str(const IOBackend& backend);
+
     // instantiate the Parquet file writer with the loaded layout, metadata, and
     // other specific configuration
     void initialize();
@@ -117,6 +320,70 @@ class Writer {
     // write to value_type and list[value_type] columns
     void fill(const std::string& field_path, const value_t& data_value);
 
+    // write a string to a string or binary column, its bytes going straight
+    // into the column (without first being copied into a value_t)
+    void fill(const std::string& field_path, std::string_view data_value);
+    void fill(const std::string& field_path, const std::string& data_value) {
+        this->fill(field_path, std::string_view(data_value));
+    }
+    void fill(const std::string& field_path, const char* data_value) {
+        this->fill(field_path, std::string_view(data_value));
+    }
+
+    // write a list of strings to a list1d[string] (or binary) column, their
+    // bytes going straight into the column
+    void fill(const std::string& field_path,
+              const std::vector<std::string_view>& data_values);
+
+    // write the n values (in row-major order) of an entry of a fixed_list or
+    // list1d column straight from memory, for T any of the numeric value
+    // types (e.g. floats to a float16 column)
+    template <typename T>
+    void fill(const std::string& field_path, const T* data_values, size_t n);
+
+    // write the values of an entry of a fixed_list column
+    template <typename T, size_t N>
+    void fill(const std::string& field_path,
+              const std::array<T, N>& data_values) {
+        this->fill(field_path, data_values.data(), N);
+    }
+
+    // write the entry of a map column made of the n keys and the n values
+    // that they map to, straight from memory, for K and V numeric types
+    template <typename K, typename V>
+    void fill(const std::string& field_path, const K* keys, const V* values,
+              size_t n) {
+        this->fill_map(field_path, keys, ctype_datatype<K>(), n, values,
+                       ctype_datatype<V>(), n);
+    }
+
+    // write the entry of a map column made of the keys and the values that
+    // they map to
+    template <typename K, typename V>
+    void fill(const std::string& field_path, const std::vector<K>& keys,
+              const std::vector<V>& values) {
+        this->fill_map(field_path, keys.data(), ctype_datatype<K>(),
+                       keys.size(), values.data(), ctype_datatype<V>(),
+                       values.size());
+    }
+
+    // write a std::chrono::duration to a duration or timestamp column,
+    // converted to the unit of the column
+    template <typename Rep, typename Period>
+    void fill(const std::string& field_path,
+              const std::chrono::duration<Rep, Period>& data_value) {
+        this->fill_ticks(field_path, static_cast<int64_t>(data_value.count()),
+                         Period::num, Period::den);
+    }
+
+    // write a std::chrono::time_point to a timestamp or date32 column, as the
+    // time since the epoch of its clock (the unix epoch for system_clock)
+    template <typename Clock, typename Duration>
+    void fill(const std::string& field_path,
+              const std::chrono::time_point<Clock, Duration>& data_value) {
+        this->fill(field_path, data_value.time_since_epoch());
+    }
+
     // write to a struct-typed column using field_buffer_t inputs
     void fill(const std::string& field_path,
               const struct_buffer_t& struct_buffer_data);
@@ -128,23 +395,117 @@ class Writer {
     // signal that writing to a given row has finished
     void end_row();
 
-    // writing to the output file has finished
-    void finish();
+    // writing to the output file has finished, returns the contents of the
+    // (last) output file when writing to memory and nullptr otherwise
+    std::shared_ptr<arrow::Buffer> finish();
 
  private:
+    // an open output Parquet file and the streams writing to it
+    struct OutputFile {
+        std::string path;
+
+        // the un-buffered stream wrapping the output file, counting the
+        // writes that actually reach it, and the (buffered) stream that the
+        // Parquet writer writes to
+        std::shared_ptr<streams::CountingOutputStream> file_stream;
+        std::shared_ptr<arrow::io::BufferOutputStream> buffer_stream;
+        std::shared_ptr<arrow::io::OutputStream> stream;
+        std::unique_ptr<parquet::arrow::FileWriter> file_writer;
+
+        // the number of rows written and when the file was opened
+        uint64_t n_rows = 0;
+        std::chrono::steady_clock::time_point open_time;
+
+        // the state needed to apply the durability policy
+        uint32_t n_row_groups_since_sync = 0;
+        std::chrono::steady_clock::time_point last_sync_time;
+
+        // the last RowGroup written to this file (used to close the least
+        // recently used partition files)
+        uint64_t last_row_group = 0;
+
+        // the file offsets up to which the writeback has been started, and
+        // up to which the written data has been dropped from the page cache
+        int64_t writeback_offset = 0;
+        int64_t released_offset = 0;
+
+        // whether disk space was reserved beyond the end of the file
+        bool preallocated = false;
+    };
+
+    // the rows of the current RowGroup that go to a given partition, with
+    // null row indices when all rows go to it
+    struct PartitionRows {
+        std::string partition;
+        std::shared_ptr<arrow::Array> row_indices;
+        int64_t n_rows;
+    };
+
+    // where the output files are written to: the output directory (FILES),
+    // in-memory buffers (BUFFER), or a user-provided stream (STREAM)
+    enum class OutputSink { FILES, BUFFER, STREAM };
+
     // Parquet output wrtier
-    std::unique_ptr<parquet::arrow::FileWriter> _file_writer;
     std::shared_ptr<arrow::fs::FileSystem> _fs;
     std::shared_ptr<arrow::fs::SubTreeFileSystem> _internal_fs;
-    std::shared_ptr<arrow::io::OutputStream> _output_stream;
-
-    // output location and name
+    std::shared_ptr<parquet::WriterProperties> _writer_properties;
+    std::shared_ptr<parquet::ArrowWriterProperties> _arrow_writer_properties;
+
+    // the output files currently being written to, the next output files
+    // while they are being opened, and the previous output files while they
+    // are being closed (the latter two happen in the background), keyed
+    // by partition directory (empty when not partitioning the output) and
+    // with one file per shard
+    std::map<std::string, std::vector<OutputFile>> _outputs;
+    std::map<std::string, std::vector<std::future<OutputFile>>>
+        _pending_outputs;
+    std::vector<std::future<WriterStats>> _pending_closes;
+
+    // the in-memory files closed concurrently in the background are handed
+    // to the buffer callback one at a time
+    std::mutex _buffer_callback_mutex;
+
+    // output location and name, and the location's path on the filesystem
     std::string _output_directory;
+    std::string _output_path;
     std::string _dataset_name;
 
-    // the index of the current file being written to (useful for
-    // cases where the output dataset is partitioned into multiple files)
-    uint32_t _file_count;
+    // where the output files are written to, and the user-provided stream
+    // or the callback receiving the in-memory files (if any)
+    OutputSink _output_sink;
+    std::shared_ptr<arrow::io::OutputStream> _user_stream;
+    BufferCallback _buffer_callback;
+
+    // the pipe to open as the output stream, and whether the output stream
+    // is closed by finish() (i.e. it was not provided by the user)
+    std::string _output_pipe;
+    bool _close_user_stream;
+
+    // the index of the current file being written to in each partition
+    // directory (useful for cases where the output dataset is partitioned
+    // into multiple files)
+    std::map<std::string, uint32_t> _file_counts;
+
+    // the columns whose values route the rows into key=value/ partition
+    // directories, the cap on the number of open partition files, and
+    // whether the partition columns are left out of the data files
+    std::vector<std::string> _partition_columns;
+    uint32_t _max_open_partitions;
+    bool _drop_partition_columns;
+
+    // the columns by which the rows of each RowGroup are ordered
+    std::vector<std::string> _sort_columns;
+
+    // the requested number of shards, or the explicit assignment of the
+    // top-level columns to shards
+    uint32_t _n_shards;
+    std::vector<std::vector<std::string>> _shard_layout;
+
+    // the names of the columns stored in each shard, and the layout of each
+    // shard file (a single shard holding all of the columns when not
+    // sharding the output)
+    std::vector<std::vector<std::string>> _shard_columns;
+    std::vector<std::shared_ptr<arrow::Schema>> _shard_schemas;
 
     // the number of rows in a given RowGroup to write in the output
     // Parquet file
@@ -168,19 +529,103 @@ class Writer {
     // written to the output Parquet file
     uint32_t _n_current_rows_filled;
 
-    // the set compression algorithm for the output Parquet file
+    // the set compression algorithm (and level) for the output Parquet file,
+    // and those set for specific fields (keyed by field path)
+    struct ColumnCompression {
+        Compression compression;
+        int level;
+    };
     Compression _compression;
+    int _compression_level;
+    std::map<std::string, ColumnCompression> _column_compression;
+
+    // the encoding settings of specific fields (keyed by field path): the
+    // encoding of the (non-dictionary) data pages, if given, and whether
+    // dictionary encoding is enabled, if given (giving an encoding disables
+    // it unless enabled explicitly)
+    struct ColumnEncoding {
+        std::optional<parquet::Encoding::type> encoding;
+        std::optional<bool> dictionary;
+    };
+    std::map<std::string, ColumnEncoding> _column_encoding;
+
+    // whether the compression of each column is chosen by trial on the
+    // first RowGroup (and whether that has happened yet, and with which
+    // results), the minimum compression throughput (MB/s), the fraction of
+    // the RowGroup tried, and the candidate algorithms and levels
+    bool _tune_compression;
+    bool _compression_tuned;
+    std::map<std::string, ColumnCompression> _tuned_compression;
+    double _tuning_min_throughput;
+    double _tuning_sample_fraction;
+    std::vector<std::pair<Compression, int>> _tuning_candidates;
 
     // the set flush rule algorithm
     FlushRule _flush_rule;
 
-    // the set data pagesize for the output Parquet file
+    // the set write mode: either the whole RowGroup is materialized as an
+    // arrow::Table (TABLE) or each column chunk is written and released
+    // one at a time (STREAM)
+    WriteMode _write_mode;
+
+    // the set durability policy and its associated RowGroup count or
+    // interval (in seconds)
+    Durability _durability;
+    uint32_t _durability_n;
+
+    // the set file rotation rule and its associated limit
+    RotationRule _rotation_rule;
+    uint64_t _rotation_n;
+
+    // the size of the user-space output buffer
+    int64_t _output_buffer_size;
+
+    // whether written data is dropped from the page cache
+    bool _release_page_cache;
+
+    // whether disk space is reserved for the output files, and for how many
+    // bytes (0 to derive it from the rotation rule)
+    bool _preallocate;
+    uint64_t _preallocation_hint;
+
+    // the set output I/O backend and the number of io_uring buffers in
+    // flight
+    IOBackend _io_backend;
+    uint32_t _uring_queue_depth;
+
+    // counters describing what has been written so far (not including the
+    // counts of the currently open output file)
+    WriterStats _stats;
+
+    // the set data pagesize for the output Parquet file, the maximum number
+    // of rows in a page (0 for the library default), and whether the page
+    // index is written (for all columns and for specific fields)
     uint32_t _data_pagesize;
+    int64_t _max_rows_per_page;
+    bool _page_index;
+    std::map<std::string, bool> _column_page_index;
+
+    // the number of mantissa bits kept for the floating point values under
+    // specific fields (keyed by field path), the others being zeroed
+    std::map<std::string, int> _keep_mantissa_bits;
+
+    // whether the column statistics are written, for all columns and for
+    // specific fields (keyed by field path)
+    bool _statistics;
+    std::map<std::string, bool> _column_statistics;
+
+    // the bloom filters requested for specific fields (keyed by field path):
+    // the expected number of distinct values (0 to let the Parquet library
+    // decide) and the false positive probability
+    struct ColumnBloomFilter {
+        int64_t ndv;
+        double fpp;
+    };
+    std::map<std::string, ColumnBloomFilter> _column_bloom_filter;
 
     // layout of the output Parquet File
     std::shared_ptr<arrow::Schema> _schema;
     std::vector<std::shared_ptr<arrow::Field>> _columns;
-    std::vector<std::shared_ptr<arrow::Array>> _arrays;
     nlohmann::json _file_metadata;
 
     // mapping between each of the columns/fields expected to be passed to
@@ -188,11 +633,144 @@ class Writer {
     std::map<std::string, std::map<std::string, arrow::ArrayBuilder*>>
         _column_builder_map;
 
+    // the top-level builders of the columns with 32-bit offsets (lists,
+    // maps, strings), with the largest offset that each of them held when
+    // last measured, upper bounds on how much it has grown since then and
+    // during the row in progress, and the most that it has grown by in a
+    // single row
+    struct OffsetWatch {
+        std::string column_name;
+        arrow::ArrayBuilder* builder;
+        int64_t offset = 0;
+        int64_t added = 0;
+        int64_t row_growth = 0;
+        int64_t max_row_growth = 0;
+    };
+    std::vector<OffsetWatch> _offset_watches;
+    std::map<std::string, size_t> _offset_watch_index;
+
+    // the columns finished ahead of a flush of the complete rows only
+    std::map<std::string, std::shared_ptr<arrow::Array>> _finished_columns;
+
     //
     // methods
     //
-    void update_output_stream();
-    void new_file();
+    // the name of the next output file of the given shard in the given
+    // partition directory
+    std::string output_filename(const std::string& partition,
+                                size_t shard) const;
+
+    // start opening the next output files in the background
+    void update_output_stream(const std::string& partition = "");
+
+    // get the open output files (one per shard) for the given partition
+    // directory, waiting for (or starting) their opening if needed
+    std::vector<OutputFile>& output(const std::string& partition = "");
+
+    // add the counts of the output files that have been closed in the
+    // background, waiting for those still being closed if wait is set
+    void collect_closed(bool wait);
+
+    // add the counts of a closed output file to the overall counts
+    void add_closed_stats(const WriterStats& closed_stats);
+
+    // open/close an output file and its associated streams
+    OutputFile open_output_file(const std::string& partition, size_t shard,
+                                const std::string& filename,
+                                int64_t preallocation) const;
+    WriterStats close_output_file(
+        OutputFile output,
+        std::shared_ptr<arrow::Buffer>* finished_buffer = nullptr) const;
+
+    // the number of bytes to reserve for each next output file (0 for none)
+    int64_t preallocation_size();
+
+    // hand the given output files over to be closed in the background
+    void close_in_background(std::vector<OutputFile> outputs);
+
+    // hand the current output files of the given partition directory over
+    // to be closed in the background and start new ones
+    void new_file(const std::string& partition = "");
+
+    // whether any of the given output files has passed the rotation limit
+    bool rotation_due(const std::vector<OutputFile>& outputs) const;
+
+    // close partition files until no more than the allowed number are open
+    void close_stale_partitions();
+
+    // split the rows of the current RowGroup by partition given the
+    // (finished) partition column arrays
+    std::vector<PartitionRows> partition_rows(
+        const std::map<std::string, std::shared_ptr<arrow::Array>>&
+            partition_arrays) const;
+
+    // finish the builder of the given (top-level) column, applying any
+    // mantissa truncation to its values
+    std::shared_ptr<arrow::Array> finish_column(
+        const std::string& column_name) const;
+
+    // the finished array of the given column as it is written out
+    std::shared_ptr<arrow::Array> stored_array(
+        const std::string& column_name,
+        std::shared_ptr<arrow::Array> array) const;
+
+    // order the rows of each partition by the (finished) sort column arrays,
+    // returning the bytes taken up by the row orderings
+    int64_t sort_rows(
+        const std::map<std::string, std::shared_ptr<arrow::Array>>& finished,
+        std::vector<PartitionRows>& partitions) const;
+
+    // the Arrow codec implementing the given compression algorithm
+    static arrow::Compression::type arrow_compression(
+        const Compression& compression);
+
+    // call apply for each Parquet leaf column under each of the given fields,
+    // with the fields in order of depth so that the settings of deeper fields
+    // override those of the fields containing them, throwing if a field has
+    // no leaf columns
+    void for_each_leaf_column(
+        const std::vector<std::string>& field_paths, const std::string& setting,
+        const std::function<void(const parquet::ColumnDescriptor*,
+                                 const std::string&)>& apply) const;
+
+    // apply the per-field compression settings to the Parquet leaf columns
+    // under each field
+    void apply_column_compression(
+        parquet::WriterProperties::Builder& builder) const;
+
+    // apply the per-field encoding settings to the Parquet leaf columns
+    // under each field, checking that the encodings are supported
+    void apply_column_encoding(
+        parquet::WriterProperties::Builder& builder) const;
+
+    // apply the statistics settings, globally and for the Parquet leaf
+    // columns under specific fields
+    void apply_column_statistics(
+        parquet::WriterProperties::Builder& builder) const;
+
+    // request the bloom filters of the Parquet leaf columns under the fields
+    // that have one
+    void apply_column_bloom_filter(
+        parquet::WriterProperties::Builder& builder) const;
+
+    // apply the page size and page index settings
+    void apply_page_settings(parquet::WriterProperties::Builder& builder) const;
+
+    // set up the Parquet writer properties shared by all output files
+    void configure_writer_properties(
+        parquet::WriterProperties::Builder& builder) const;
+
+    // choose the compression of each column from trials on the given
+    // (finished) arrays, recording the choices in the file metadata
+    void tune_compression(
+        const std::map<std::string, std::shared_ptr<arrow::Array>>& arrays);
+
+    // whether the given column is stored in the output data files
+    bool column_in_files(const std::string& column_name) const;
+
+    // assign the stored columns to shards and build the layout of each
+    // shard file
+    void assign_shards();
 
     // signals that filling of a given column/field has been completed
     void end_fill(const std::string& field_path);
@@ -201,6 +779,29 @@ class Writer {
     // struct-type column
     std::vector<std::string> struct_fill_order(const std::string& field_path);
 
+    // the builder filled by Writer::fill(...) calls for the given value_type
+    // and list[value_type] column/field
+    arrow::ArrayBuilder* value_builder(const std::string& field_path);
+
+    // the arrow type of the values of the given C type
+    template <typename T>
+    static std::shared_ptr<arrow::DataType> ctype_datatype() {
+        return arrow::TypeTraits<
+            typename arrow::CTypeTraits<T>::ArrowType>::type_singleton();
+    }
+
+    // fill the map entry of the given keys and values, of the given types
+    void fill_map(const std::string& field_path, const void* keys,
+                  const std::shared_ptr<arrow::DataType>& key_type,
+                  size_t n_keys, const void* values,
+                  const std::shared_ptr<arrow::DataType>& value_type,
+                  size_t n_values);
+
+    // fill the given number of ticks (of num/den seconds each) to a
+    // timestamp, duration or date32 column, in the unit of the column
+    void fill_ticks(const std::string& field_path, int64_t ticks,
+                    intmax_t num, intmax_t den);
+
     // fill an instance of a value_type and list[value_type] data element
     void fill_value(const std::string& field_name, arrow::ArrayBuilder* builder,
                     const value_t& input_data);
@@ -262,6 +863,22 @@ class Writer {
     bool row_is_complete();
     void flush_if_ready();
 
+    // check whether the next row may overflow the 32-bit offsets of any of
+    // the columns
+    bool offsets_near_limit();
+
+    // the offset watch of the column of the given column/field, if any
+    OffsetWatch* offset_watch(const std::string& field_path);
+
+    // make room in the builder of the watched column for a value that moves
+    // its 32-bit offsets by (up to) the given amount, flushing the complete
+    // rows first if the value would not fit
+    void reserve_offsets(OffsetWatch& watch, int64_t growth);
+
+    // flush the complete rows, with the values already filled for the row
+    // in progress put back into the (emptied) builders
+    void flush_complete_rows();
+
     // call AppendEmptyValue on a column \"field_path\"
     void append_empty_value(const std::string& field_path);
 
@@ -271,6 +888,33 @@ class Writer {
     // flush the current in-memory data (rows) to the output Parquet file
     void flush();
 
+    // push the written data out to the output file according to the
+    // durability policy (unconditionally, if force is set)
+    void sync_output(OutputFile& output, bool force, WriterStats& stats) const;
+
+    // drop the data written to the output file from the page cache: the
+    // range written before the previous call is waited for and dropped,
+    // while the writeback of the newly written range is only started (all
+    // of it is waited for and dropped if all is set)
+    void release_page_cache(OutputFile& output, bool all) const;
+
+    // write the current RowGroup of the given shard as a single arrow::Table
+    // per partition, given the arrays of any columns that have already been
+    // finished, returning the largest number of bytes held at once by the
+    // reordered copies of the columns
+    int64_t flush_table(
+        size_t shard, const std::vector<PartitionRows>& partitions,
+        const std::vector<std::vector<OutputFile>*>& outputs,
+        const std::map<std::string, std::shared_ptr<arrow::Array>>& finished);
+
+    // write the current RowGroup of the given shard one column chunk at a
+    // time, returning the largest number of bytes held at once by the
+    // reordered copies of the columns
+    int64_t flush_stream(
+        size_t shard, const std::vector<PartitionRows>& partitions,
+        const std::vector<std::vector<OutputFile>*>& outputs,
+        const std::map<std::string, std::shared_ptr<arrow::Array>>& finished);
+
     //
     // logging
     //
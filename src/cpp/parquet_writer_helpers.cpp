@@ -2,9 +2,25 @@
 
 #include "parquet_writer_exceptions.h"
 
+// arrow
+#include <arrow/util/compression.h>
+
 // std/stl
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <limits>
 #include <sstream>
 
+// the AVX2 and F16C code paths are built on x86 whatever the target of the
+// build, and taken only where the CPU running the code supports them
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PARQUETWRITER_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace parquetwriter {
 namespace helpers {
 
@@ -12,13 +28,121 @@ std::shared_ptr<arrow::DataType> datatype_from_string(
     const std::string& type_string) {
     std::shared_ptr<arrow::DataType> out_type = nullptr;
     if (internal::type_init_map.count(type_string) == 0) {
-        throw parquetwriter::layout_exception(
-            "Unsupported type \"" + type_string + "\" specified in layout");
+        out_type = parameterized_datatype_from_string(type_string);
+        if (!out_type) {
+            throw parquetwriter::layout_exception(
+                "Unsupported type \"" + type_string + "\" specified in layout");
+        }
+        return out_type;
     }
     internal::ArrowTypeInit TypeInit;
     return (TypeInit.*(internal::type_init_map.at(type_string)))();
 }
 
+std::shared_ptr<arrow::DataType> parameterized_datatype_from_string(
+    const std::string& type_string) {
+    // types of the form "name[param, ...]" or "name(param, ...)"
+    size_t open = type_string.find_first_of("[(");
+    if (open == std::string::npos || type_string.size() < open + 2) {
+        return nullptr;
+    }
+    char close = type_string.at(open) == '[' ? ']' : ')';
+    if (type_string.back() != close) {
+        return nullptr;
+    }
+    std::string name = type_string.substr(0, open);
+    std::vector<std::string> params;
+    std::stringstream sparams(
+        type_string.substr(open + 1, type_string.size() - open - 2));
+    std::string param;
+    while (std::getline(sparams, param, ',')) {
+        size_t first = param.find_first_not_of(' ');
+        size_t last = param.find_last_not_of(' ');
+        params.push_back(first == std::string::npos
+                             ? ""
+                             : param.substr(first, last - first + 1));
+    }
+
+    auto time_unit = [&type_string](const std::string& unit) {
+        static const std::map<std::string, arrow::TimeUnit::type> units = {
+            {"s", arrow::TimeUnit::SECOND},
+            {"ms", arrow::TimeUnit::MILLI},
+            {"us", arrow::TimeUnit::MICRO},
+            {"ns", arrow::TimeUnit::NANO}};
+        if (units.count(unit) == 0) {
+            throw parquetwriter::layout_exception(
+                "Invalid time unit \"" + unit + "\" for type \"" +
+                type_string + "\", expected one of \"s\", \"ms\", \"us\", "
+                "or \"ns\"");
+        }
+        return units.at(unit);
+    };
+
+    if (name == "timestamp" && close == ']' &&
+        (params.size() == 1 || params.size() == 2)) {
+        // timestamp[unit] or timestamp[unit, timezone]
+        return params.size() == 1
+                   ? arrow::timestamp(time_unit(params.at(0)))
+                   : arrow::timestamp(time_unit(params.at(0)), params.at(1));
+    } else if (name == "duration" && close == ']' && params.size() == 1) {
+        // duration[unit]
+        return arrow::duration(time_unit(params.at(0)));
+    } else if (name == "decimal128" && close == ')' && params.size() == 2) {
+        // decimal128(precision, scale)
+        int32_t precision = 0;
+        int32_t scale = 0;
+        try {
+            size_t n_precision = 0;
+            size_t n_scale = 0;
+            precision = std::stoi(params.at(0), &n_precision);
+            scale = std::stoi(params.at(1), &n_scale);
+            if (n_precision != params.at(0).size() ||
+                n_scale != params.at(1).size()) {
+                precision = 0;
+            }
+        } catch (std::exception& e) {
+            precision = 0;
+        }
+        if (precision < 1 || precision > 38 || scale < 0 || scale > precision) {
+            throw parquetwriter::layout_exception(
+                "Invalid type \"" + type_string +
+                "\", expected decimal128(precision, scale) with 1 <= "
+                "precision <= 38 and 0 <= scale <= precision");
+        }
+        return arrow::decimal128(precision, scale);
+    }
+    return nullptr;
+}
+
+arrow::Type::type fill_type_id(arrow::Type::type type_id) {
+    // timestamps and durations are filled with int64 ticks of their unit,
+    // decimals with their int64 unscaled values, dates with the int32 days
+    // since the unix epoch, and half-precision floats with floats
+    switch (type_id) {
+        case arrow::Type::TIMESTAMP:
+        case arrow::Type::DURATION:
+        case arrow::Type::DECIMAL128:
+            return arrow::Type::INT64;
+        case arrow::Type::DATE32:
+            return arrow::Type::INT32;
+        case arrow::Type::HALF_FLOAT:
+            return arrow::Type::FLOAT;
+        default:
+            return type_id;
+    }
+}
+
+bool has_nanosecond_timestamps(const std::shared_ptr<arrow::DataType>& type) {
+    if (type->id() == arrow::Type::TIMESTAMP) {
+        return static_cast<const arrow::TimestampType&>(*type).unit() ==
+               arrow::TimeUnit::NANO;
+    }
+    for (const auto& field : type->fields()) {
+        if (has_nanosecond_timestamps(field->type())) return true;
+    }
+    return false;
+}
+
 void check_layout_list(const nlohmann::json& list_layout,
                        const std::string& column_name) {
     if (!(list_layout.count("contains") > 0 &&
@@ -34,6 +158,94 @@ void check_layout_list(const nlohmann::json& list_layout,
     }
 }
 
+void check_layout_dictionary(const nlohmann::json& dictionary_layout,
+                             const std::string& column_name) {
+    if (!(dictionary_layout.count("contains") > 0 &&
+          dictionary_layout.at("contains").is_object() &&
+          dictionary_layout.at("contains").count("type") > 0)) {
+        throw parquetwriter::layout_exception(
+            "Invalid JSON layout for dictionary type column \"" +
+            column_name + "\", expected a \"contains\" object with a " +
+            "\"type\"");
+    }
+    auto value_type = dictionary_layout.at("contains").at("type");
+    if (value_type != "string" && value_type != "binary") {
+        throw parquetwriter::layout_exception(
+            "Unsupported value type " + value_type.dump() +
+            " for dictionary type column \"" + column_name +
+            "\", expected \"string\" or \"binary\"");
+    }
+}
+
+std::vector<int32_t> check_layout_fixed_list(
+    const nlohmann::json& fixed_list_layout, const std::string& column_name) {
+    check_layout_list(fixed_list_layout, column_name);
+    auto value_type = fixed_list_layout.at("contains").at("type");
+    if (!value_type.is_string() || value_type == "bool" ||
+        value_type == "string" || value_type == "binary" ||
+        value_type == "large_string" || value_type == "large_binary" ||
+        internal::type_init_map.count(value_type.get<std::string>()) == 0) {
+        throw parquetwriter::layout_exception(
+            "Unsupported value type " + value_type.dump() +
+            " for fixed_list type column \"" + column_name +
+            "\", expected a numeric type");
+    }
+
+    // the size of each dimension, outermost first (e.g. [3, 3] for a 3x3
+    // matrix stored row by row)
+    std::vector<int32_t> sizes;
+    auto jsize = fixed_list_layout.count("size") > 0
+                     ? fixed_list_layout.at("size")
+                     : nlohmann::json();
+    if (jsize.is_number_integer()) {
+        jsize = nlohmann::json::array({jsize});
+    }
+    if (jsize.is_array() && jsize.size() > 0 && jsize.size() <= 3) {
+        for (const auto& jdim : jsize) {
+            if (!jdim.is_number_integer() || jdim.get<int64_t>() <= 0 ||
+                jdim.get<int64_t>() > std::numeric_limits<int32_t>::max()) {
+                sizes.clear();
+                break;
+            }
+            sizes.push_back(jdim.get<int32_t>());
+        }
+    }
+    if (sizes.empty()) {
+        throw parquetwriter::layout_exception(
+            "Invalid \"size\" for fixed_list type column \"" + column_name +
+            "\", expected a positive integer or an array of (at most 3) "
+            "positive integers");
+    }
+    return sizes;
+}
+
+std::pair<std::shared_ptr<arrow::DataType>, std::shared_ptr<arrow::DataType>>
+check_layout_map(const nlohmann::json& map_layout,
+                 const std::string& column_name) {
+    std::vector<std::shared_ptr<arrow::DataType>> types;
+    for (std::string part : {"keys", "values"}) {
+        if (!(map_layout.count(part) > 0 && map_layout.at(part).is_object() &&
+              map_layout.at(part).count("type") > 0 &&
+              map_layout.at(part).at("type").is_string())) {
+            throw parquetwriter::layout_exception(
+                "Invalid JSON layout for map type column \"" + column_name +
+                "\", expected a \"" + part + "\" object with a \"type\"");
+        }
+        auto type_string = map_layout.at(part).at("type").get<std::string>();
+        auto type = datatype_from_string(type_string);
+        // keys and values are filled from memory, as numbers
+        auto id = fill_type_id(type->id());
+        if (!(arrow::is_integer(id) || arrow::is_floating(id))) {
+            throw parquetwriter::layout_exception(
+                "Unsupported " + part.substr(0, part.size() - 1) + " type \"" +
+                type_string + "\" for map type column \"" + column_name +
+                "\", expected a numeric type");
+        }
+        types.push_back(type);
+    }
+    return std::make_pair(types.at(0), types.at(1));
+}
+
 void check_layout_struct(const nlohmann::json& struct_layout,
                          const std::string& column_name) {
     if (!(struct_layout.count("fields") > 0 &&
@@ -72,6 +284,25 @@ std::vector<std::shared_ptr<arrow::Field>> columns_from_json(
                 (field_type == "list1d" ? 1 : (field_type == "list2d" ? 2 : 3));
             auto jcontains = jfield.at("contains");
             auto type_string = jcontains.at("type").get<std::string>();
+
+            // lists with 64-bit offsets, whose values in a RowGroup may number
+            // more than 2^31
+            bool large = false;
+            if (jfield.count("large") > 0) {
+                if (!jfield.at("large").is_boolean()) {
+                    throw parquetwriter::layout_exception(
+                        "Invalid \"large\" for list type column \"" +
+                        field_name + "\", expected true or false");
+                }
+                large = jfield.at("large").get<bool>();
+            }
+            if (large && (!current_node.empty() || type_string == "struct")) {
+                throw parquetwriter::layout_exception(
+                    "Large list type field \"" + field_name +
+                    "\" is not supported, only top-level lists of values can "
+                    "be large lists");
+            }
+
             std::shared_ptr<arrow::DataType> list_type;
             if (type_string == "struct") {
                 check_layout_struct(jcontains, field_name);
@@ -85,9 +316,45 @@ std::vector<std::shared_ptr<arrow::Field>> columns_from_json(
             unsigned level = 0;
             while (level < depth) {
                 level++;
-                list_type = arrow::list(list_type);
+                list_type = large ? arrow::large_list(list_type)
+                                  : arrow::list(list_type);
             }
             fields.push_back(arrow::field(field_name, list_type));
+        } else if (field_type == "fixed_list") {
+            // fixed-size list types, nested for each dimension
+            auto sizes = check_layout_fixed_list(jfield, field_name);
+            auto list_type = datatype_from_string(
+                jfield.at("contains").at("type").get<std::string>());
+            for (auto size = sizes.rbegin(); size != sizes.rend(); size++) {
+                list_type = arrow::fixed_size_list(list_type, *size);
+            }
+            fields.push_back(arrow::field(field_name, list_type));
+        } else if (field_type == "map") {
+            // map type, with one entry of keys and values per row
+            if (!current_node.empty()) {
+                throw parquetwriter::layout_exception(
+                    "Map type field \"" + field_name + "\" of \"" +
+                    current_node +
+                    "\" is not supported, only top-level columns can be "
+                    "of map type");
+            }
+            auto [key_type, value_type] = check_layout_map(jfield, field_name);
+            fields.push_back(
+                arrow::field(field_name, arrow::map(key_type, value_type)));
+        } else if (field_type == "dictionary") {
+            // dictionary-encoded (categorical) type
+            if (!current_node.empty()) {
+                throw parquetwriter::layout_exception(
+                    "Dictionary type field \"" + field_name + "\" of \"" +
+                    current_node +
+                    "\" is not supported, only top-level columns can be "
+                    "of dictionary type");
+            }
+            check_layout_dictionary(jfield, field_name);
+            auto value_type = datatype_from_string(
+                jfield.at("contains").at("type").get<std::string>());
+            fields.push_back(arrow::field(
+                field_name, arrow::dictionary(arrow::int32(), value_type)));
         } else if (field_type == "struct") {
             // struct type
             check_layout_struct(jfield, field_name);
@@ -122,7 +389,19 @@ fill_field_builder_map_from_columns(
 
         auto pool = arrow::default_memory_pool();
         std::unique_ptr<arrow::ArrayBuilder> tmp;
-        PARQUET_THROW_NOT_OK(arrow::MakeBuilder(pool, column_type, &tmp));
+        if (column_type->id() == arrow::Type::DICTIONARY) {
+            // builders with int32 indices, matching the layout's type (the
+            // generic builders pick the smallest index type that fits)
+            const auto& dictionary_type =
+                static_cast<const arrow::DictionaryType&>(*column_type);
+            if (dictionary_type.value_type()->id() == arrow::Type::STRING) {
+                tmp.reset(new arrow::StringDictionary32Builder(pool));
+            } else {
+                tmp.reset(new arrow::BinaryDictionary32Builder(pool));
+            }
+        } else {
+            PARQUET_THROW_NOT_OK(arrow::MakeBuilder(pool, column_type, &tmp));
+        }
 
         // this is the top-level ArrayBuilder for this column,
         // all other builders for any sub-arrays (e.g. list or struct types)
@@ -189,10 +468,8 @@ struct_type_field_builders(arrow::ArrayBuilder* builder,
 
         if (is_list) {
             // check if struct_list
-            auto list_builder =
-                dynamic_cast<arrow::ListBuilder*>(field_builder);
             auto [depth, terminal_builder] =
-                list_builder_description(list_builder);
+                list_builder_description(field_builder);
             if (terminal_builder->type()->id() == arrow::Type::STRUCT) {
                 names.push_back(field_name);
                 out.push_back(field_builder);
@@ -206,28 +483,113 @@ struct_type_field_builders(arrow::ArrayBuilder* builder,
 }
 
 std::pair<unsigned, arrow::ArrayBuilder*> list_builder_description(
-    arrow::ListBuilder* builder) {
+    arrow::ArrayBuilder* builder) {
     unsigned depth = 1;
-    auto list_builder = builder;
-    auto value_builder = list_builder->value_builder();
+    auto value_builder = list_value_builder(builder);
 
     size_t unpack_count = 0;
-    while (value_builder->type()->id() == arrow::Type::LIST) {
+    while (is_list_type(value_builder->type()->id())) {
         if (unpack_count >= 3) break;
         depth++;
-        list_builder = dynamic_cast<arrow::ListBuilder*>(value_builder);
-        value_builder = list_builder->value_builder();
+        value_builder = list_value_builder(value_builder);
         unpack_count++;
     }
     return std::make_pair(depth, value_builder);
 }
 
+bool is_list_type(arrow::Type::type type_id) {
+    return type_id == arrow::Type::LIST || type_id == arrow::Type::LARGE_LIST;
+}
+
+arrow::ArrayBuilder* list_value_builder(arrow::ArrayBuilder* builder) {
+    if (builder->type()->id() == arrow::Type::LARGE_LIST) {
+        return dynamic_cast<arrow::LargeListBuilder*>(builder)
+            ->value_builder();
+    }
+    return dynamic_cast<arrow::ListBuilder*>(builder)->value_builder();
+}
+
+arrow::Status list_builder_append(arrow::ArrayBuilder* builder) {
+    if (builder->type()->id() == arrow::Type::LARGE_LIST) {
+        return dynamic_cast<arrow::LargeListBuilder*>(builder)->Append();
+    }
+    return dynamic_cast<arrow::ListBuilder*>(builder)->Append();
+}
+
+bool has_int32_offsets(const std::shared_ptr<arrow::DataType>& type) {
+    switch (type->id()) {
+        case arrow::Type::LIST:
+        case arrow::Type::MAP:
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY:
+            return true;
+        case arrow::Type::DICTIONARY:
+            return false;
+        default:
+            for (const auto& field : type->fields()) {
+                if (has_int32_offsets(field->type())) return true;
+            }
+            return false;
+    }
+}
+
+int64_t max_int32_offset(arrow::ArrayBuilder* builder) {
+    // the number of values of the lists (and maps) and the number of bytes of
+    // the strings (and binaries), which the offsets written when finishing
+    // the builder run up to
+    int64_t offset = 0;
+    switch (builder->type()->id()) {
+        case arrow::Type::LIST: {
+            auto value_builder = list_value_builder(builder);
+            offset = std::max(value_builder->length(),
+                              max_int32_offset(value_builder));
+            break;
+        }
+        case arrow::Type::LARGE_LIST: {
+            offset = max_int32_offset(list_value_builder(builder));
+            break;
+        }
+        case arrow::Type::FIXED_SIZE_LIST: {
+            offset = max_int32_offset(
+                dynamic_cast<arrow::FixedSizeListBuilder*>(builder)
+                    ->value_builder());
+            break;
+        }
+        case arrow::Type::MAP: {
+            auto map_builder = dynamic_cast<arrow::MapBuilder*>(builder);
+            offset = std::max({map_builder->key_builder()->length(),
+                               max_int32_offset(map_builder->key_builder()),
+                               max_int32_offset(map_builder->item_builder())});
+            break;
+        }
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY: {
+            offset = dynamic_cast<arrow::BinaryBuilder*>(builder)
+                         ->value_data_length();
+            break;
+        }
+        case arrow::Type::STRUCT: {
+            auto struct_builder = dynamic_cast<arrow::StructBuilder*>(builder);
+            for (int ichild = 0; ichild < struct_builder->num_children();
+                 ichild++) {
+                offset = std::max(
+                    offset, max_int32_offset(
+                                struct_builder->child_builder(ichild).get()));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return offset;
+}
+
 parquetwriter::FillType column_filltype_from_builder(
     arrow::ArrayBuilder* column_builder, const std::string& column_name) {
     //
     // if there are any nested data structures, get the associated builders
     //
-    bool is_list = column_builder->type()->id() == arrow::Type::LIST;
+    bool is_list = is_list_type(column_builder->type()->id());
     bool is_struct = column_builder->type()->id() == arrow::Type::STRUCT;
 
     // For FillTypes::VALUE_LIST_{1D,2D,3D} we do not need entries
@@ -235,10 +597,10 @@ parquetwriter::FillType column_filltype_from_builder(
     // top level
 
     if (is_list) {
-        auto list_builder = dynamic_cast<arrow::ListBuilder*>(column_builder);
-        auto [depth, terminal_builder] = list_builder_description(list_builder);
+        auto [depth, terminal_builder] =
+            list_builder_description(column_builder);
 
-        if (terminal_builder->type()->id() == arrow::Type::LIST) {
+        if (is_list_type(terminal_builder->type()->id())) {
             throw parquetwriter::layout_exception(
                 "Invalid list depth (depth>3) encountered in column/field \"" +
                 column_name + "\"");
@@ -500,5 +862,742 @@ std::string parent_column_name_from_field(const std::string& field_path) {
     return parent_column_name;
 }
 
+std::vector<std::string> value_columns_from_json(
+    const json& jlayout, const std::string& option,
+    const std::string& description,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns) {
+    std::vector<std::string> value_columns;
+    if (jlayout.count(option) == 0) {
+        return value_columns;
+    }
+
+    auto joption = jlayout.at(option);
+    if (!joption.is_array()) {
+        throw parquetwriter::layout_exception(
+            "\"" + option + "\" must be an array of column names");
+    }
+    for (const auto& jcolumn : joption) {
+        if (!jcolumn.is_string()) {
+            throw parquetwriter::layout_exception(
+                "\"" + option + "\" must be an array of column names");
+        }
+        std::string column_name = jcolumn.get<std::string>();
+        auto column = std::find_if(columns.begin(), columns.end(),
+                                   [&column_name](const auto& field) {
+                                       return field->name() == column_name;
+                                   });
+        if (column == columns.end()) {
+            throw parquetwriter::layout_exception(
+                description + " \"" + column_name +
+                "\" is not a top-level column of the layout");
+        }
+        if ((*column)->type()->num_fields() > 0) {
+            throw parquetwriter::layout_exception(
+                description + " \"" + column_name + "\" has nested type \"" +
+                (*column)->type()->name() + "\", only value types are allowed");
+        }
+        if (std::find(value_columns.begin(), value_columns.end(),
+                      column_name) != value_columns.end()) {
+            throw parquetwriter::layout_exception(
+                description + " \"" + column_name +
+                "\" is specified more than once");
+        }
+        value_columns.push_back(column_name);
+    }
+    return value_columns;
+}
+
+std::vector<std::string> partition_columns_from_json(
+    const json& jlayout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns) {
+    return value_columns_from_json(jlayout, "partition_by", "Partition column",
+                                   columns);
+}
+
+std::vector<std::string> sort_columns_from_json(
+    const json& jlayout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns) {
+    auto sort_columns =
+        value_columns_from_json(jlayout, "sort_by", "Sort column", columns);
+    for (const auto& column : columns) {
+        // (the sort kernels of arrow 5 do not support dictionary arrays)
+        if (column->type()->id() == arrow::Type::DICTIONARY &&
+            std::find(sort_columns.begin(), sort_columns.end(),
+                      column->name()) != sort_columns.end()) {
+            throw parquetwriter::layout_exception(
+                "Sort column \"" + column->name() +
+                "\" has dictionary type, which cannot be sorted by");
+        }
+    }
+    return sort_columns;
+}
+
+std::string hive_partition_value(const std::string& value) {
+    // percent-encode the characters that would break up the key=value
+    // directory name (the same set that Hive escapes for path separators)
+    std::stringstream out;
+    for (unsigned char c : value) {
+        if (c == '/' || c == '=' || c == '%' || c == '\\' || c < 0x20) {
+            out << '%' << std::uppercase << std::hex << std::setw(2)
+                << std::setfill('0') << static_cast<int>(c) << std::dec;
+        } else {
+            out << c;
+        }
+    }
+    return out.str();
+}
+
+std::vector<std::vector<std::string>> check_shard_layout(
+    const std::vector<std::vector<std::string>>& shard_layout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns) {
+    std::map<std::string, size_t> column_shard;
+    for (size_t shard = 0; shard < shard_layout.size(); shard++) {
+        if (shard_layout.at(shard).empty()) {
+            throw parquetwriter::writer_exception(
+                "Shard #" + std::to_string(shard) + " holds no columns");
+        }
+        for (const auto& column_name : shard_layout.at(shard)) {
+            auto column = std::find_if(columns.begin(), columns.end(),
+                                       [&column_name](const auto& field) {
+                                           return field->name() == column_name;
+                                       });
+            if (column == columns.end()) {
+                throw parquetwriter::writer_exception(
+                    "Shard #" + std::to_string(shard) + " column \"" +
+                    column_name +
+                    "\" is not a top-level column stored in the output");
+            }
+            if (column_shard.count(column_name)) {
+                throw parquetwriter::writer_exception(
+                    "Column \"" + column_name +
+                    "\" is assigned to more than one shard");
+            }
+            column_shard[column_name] = shard;
+        }
+    }
+
+    for (const auto& column : columns) {
+        if (column_shard.count(column->name()) == 0) {
+            throw parquetwriter::writer_exception(
+                "Column \"" + column->name() + "\" is not assigned to a shard");
+        }
+    }
+
+    // the columns of each shard keep the order that they have in the layout
+    std::vector<std::vector<std::string>> shard_columns(shard_layout.size());
+    for (const auto& column : columns) {
+        shard_columns.at(column_shard.at(column->name()))
+            .push_back(column->name());
+    }
+    return shard_columns;
+}
+
+std::vector<std::vector<std::string>> balance_columns(
+    const std::vector<std::shared_ptr<arrow::Field>>& columns,
+    uint32_t n_shards) {
+    if (columns.size() < n_shards) {
+        throw parquetwriter::writer_exception(
+            "Cannot split " + std::to_string(columns.size()) +
+            " columns across " + std::to_string(n_shards) + " shards");
+    }
+
+    // greedily hand the largest remaining column to the lightest shard
+    std::vector<std::pair<double, size_t>> by_size;
+    for (size_t icolumn = 0; icolumn < columns.size(); icolumn++) {
+        by_size.push_back(
+            {estimated_value_size(columns.at(icolumn)->type()), icolumn});
+    }
+    std::stable_sort(
+        by_size.begin(), by_size.end(),
+        [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+    std::vector<double> shard_sizes(n_shards, 0.0);
+    std::vector<size_t> column_shard(columns.size(), 0);
+    for (const auto& [size, icolumn] : by_size) {
+        size_t shard = std::distance(
+            shard_sizes.begin(),
+            std::min_element(shard_sizes.begin(), shard_sizes.end()));
+        shard_sizes.at(shard) += size;
+        column_shard.at(icolumn) = shard;
+    }
+
+    // the columns of each shard keep the order that they have in the layout
+    std::vector<std::vector<std::string>> shard_columns(n_shards);
+    for (size_t icolumn = 0; icolumn < columns.size(); icolumn++) {
+        shard_columns.at(column_shard.at(icolumn))
+            .push_back(columns.at(icolumn)->name());
+    }
+    return shard_columns;
+}
+
+double estimated_value_size(const std::shared_ptr<arrow::DataType>& type) {
+    // a rough per-row size: fixed-width types take their width, strings and
+    // lists are assumed to hold a handful of bytes or elements
+    if (auto fixed_width =
+            std::dynamic_pointer_cast<arrow::FixedWidthType>(type)) {
+        return std::max(fixed_width->bit_width() / 8.0, 1.0 / 8.0);
+    }
+
+    double size = 0.0;
+    switch (type->id()) {
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY: {
+            size = 4.0 + 16.0;
+            break;
+        }
+        case arrow::Type::LARGE_STRING:
+        case arrow::Type::LARGE_BINARY: {
+            size = 8.0 + 16.0;
+            break;
+        }
+        case arrow::Type::LIST:
+        case arrow::Type::MAP: {
+            size = 4.0 + 4.0 * estimated_value_size(type->field(0)->type());
+            break;
+        }
+        case arrow::Type::LARGE_LIST: {
+            size = 8.0 + 4.0 * estimated_value_size(type->field(0)->type());
+            break;
+        }
+        case arrow::Type::FIXED_SIZE_LIST: {
+            // no offsets, and the number of values is known
+            const auto& list_type =
+                static_cast<const arrow::FixedSizeListType&>(*type);
+            size = list_type.list_size() *
+                   estimated_value_size(list_type.value_type());
+            break;
+        }
+        default: {
+            for (const auto& field : type->fields()) {
+                size += estimated_value_size(field->type());
+            }
+            break;
+        }
+    }
+    return size;
+}
+
+int64_t array_data_size(const std::shared_ptr<arrow::ArrayData>& data) {
+    // the bytes held by the buffers of the array and of its children (shared
+    // buffers are counted each time they appear)
+    int64_t size = 0;
+    for (const auto& buffer : data->buffers) {
+        if (buffer) size += buffer->size();
+    }
+    for (const auto& child : data->child_data) {
+        size += array_data_size(child);
+    }
+    return size;
+}
+
+namespace internal {
+#ifdef PARQUETWRITER_X86_DISPATCH
+bool cpu_has_avx2() {
+    static const bool has_avx2 = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return has_avx2;
+}
+
+// and the mask into each Word of the leading 256-bit blocks of the n_bytes
+// of data, returns the number of bytes done
+template <typename Word>
+__attribute__((target("avx2"))) int64_t mask_words_avx2(uint8_t* data,
+                                                         int64_t n_bytes,
+                                                         Word mask) {
+    const __m256i vmask = sizeof(Word) == 4
+                              ? _mm256_set1_epi32(static_cast<int32_t>(mask))
+                              : _mm256_set1_epi64x(static_cast<int64_t>(mask));
+    int64_t ibyte = 0;
+    for (; ibyte + 32 <= n_bytes; ibyte += 32) {
+        auto chunk = reinterpret_cast<__m256i*>(data + ibyte);
+        _mm256_storeu_si256(chunk,
+                            _mm256_and_si256(_mm256_loadu_si256(chunk), vmask));
+    }
+    return ibyte;
+}
+#endif
+
+// zero all but the keep_bits leading mantissa bits of each of the n_values
+// IEEE 754 values (of Word size, with MantissaBits mantissa bits) in data,
+// 256 bits at a time where the CPU supports AVX2
+template <typename Word, int MantissaBits>
+void truncate_mantissa(uint8_t* data, int64_t n_values, int keep_bits) {
+    if (keep_bits >= MantissaBits) return;
+    const Word mask = ~((Word(1) << (MantissaBits - keep_bits)) - 1);
+    int64_t n_bytes = n_values * static_cast<int64_t>(sizeof(Word));
+    int64_t ibyte = 0;
+#ifdef PARQUETWRITER_X86_DISPATCH
+    if (cpu_has_avx2()) {
+        ibyte = mask_words_avx2(data, n_bytes, mask);
+    }
+#endif
+    // (the compiler vectorises this loop with the SIMD instructions of the
+    // target otherwise)
+    for (; ibyte < n_bytes; ibyte += sizeof(Word)) {
+        Word word;
+        std::memcpy(&word, data + ibyte, sizeof(Word));
+        word &= mask;
+        std::memcpy(data + ibyte, &word, sizeof(Word));
+    }
+}
+};  // namespace internal
+
+void truncate_mantissa(uint8_t* float_values, int64_t n_values,
+                       int keep_bits) {
+    internal::truncate_mantissa<uint32_t, 23>(float_values, n_values,
+                                              keep_bits);
+}
+
+void truncate_mantissa_double(uint8_t* double_values, int64_t n_values,
+                              int keep_bits) {
+    internal::truncate_mantissa<uint64_t, 52>(double_values, n_values,
+                                              keep_bits);
+}
+
+void truncate_mantissas(const std::shared_ptr<arrow::ArrayData>& data,
+                        const std::string& field_path,
+                        const std::map<std::string, int>& keep_mantissa_bits) {
+    switch (data->type->id()) {
+        case arrow::Type::FLOAT:
+        case arrow::Type::DOUBLE: {
+            // the setting of the deepest field containing this one applies
+            int keep_bits = -1;
+            size_t depth = 0;
+            for (const auto& [path, bits] : keep_mantissa_bits) {
+                if ((field_path == path ||
+                     field_path.rfind(path + ".", 0) == 0) &&
+                    path.size() >= depth) {
+                    keep_bits = bits;
+                    depth = path.size();
+                }
+            }
+            if (keep_bits < 0 || !data->buffers.at(1)) return;
+
+            // the buffers of a freshly finished builder are not shared, but
+            // otherwise the values are copied before being changed
+            auto& values = data->buffers.at(1);
+            if (!values->is_mutable()) {
+                std::shared_ptr<arrow::Buffer> copy;
+                PARQUET_ASSIGN_OR_THROW(copy,
+                                        values->CopySlice(0, values->size()));
+                values = copy;
+            }
+            int64_t n_values = data->offset + data->length;
+            if (data->type->id() == arrow::Type::FLOAT) {
+                truncate_mantissa(values->mutable_data(), n_values, keep_bits);
+            } else {
+                truncate_mantissa_double(values->mutable_data(), n_values,
+                                         keep_bits);
+            }
+            break;
+        }
+        case arrow::Type::STRUCT: {
+            for (int ifield = 0; ifield < data->type->num_fields(); ifield++) {
+                truncate_mantissas(
+                    data->child_data.at(ifield),
+                    field_path + "." + data->type->field(ifield)->name(),
+                    keep_mantissa_bits);
+            }
+            break;
+        }
+        default: {
+            // lists do not add to the field path
+            for (const auto& child : data->child_data) {
+                truncate_mantissas(child, field_path, keep_mantissa_bits);
+            }
+            break;
+        }
+    }
+}
+
+std::map<std::string, json> field_option_from_json(
+    const json& jlayout, const std::string& option,
+    const std::string& current_node) {
+    std::map<std::string, json> out;
+    if (jlayout.count("fields") == 0) return out;
+
+    for (const auto& jfield : jlayout.at("fields")) {
+        auto field_name = jfield.at("name").get<std::string>();
+        std::string field_path =
+            current_node.empty() ? field_name : current_node + "." + field_name;
+        if (jfield.count(option) > 0) {
+            out[field_path] = jfield.at(option);
+        }
+
+        // the fields of structs, and of structs held in lists
+        const json* jstruct = nullptr;
+        if (jfield.count("fields") > 0) {
+            jstruct = &jfield;
+        } else if (jfield.count("contains") > 0 &&
+                   jfield.at("contains").count("fields") > 0) {
+            jstruct = &jfield.at("contains");
+        }
+        if (jstruct) {
+            auto struct_out =
+                field_option_from_json(*jstruct, option, field_path);
+            out.insert(struct_out.begin(), struct_out.end());
+        }
+    }
+    return out;
+}
+
+std::map<std::string, std::pair<std::string, int>> column_compression_from_json(
+    const json& jlayout) {
+    std::map<std::string, std::pair<std::string, int>> out;
+    for (const auto& [field_path, jcompression] :
+         field_option_from_json(jlayout, "compression")) {
+        // either just the codec name, or an object with the codec name and
+        // (optionally) its level
+        std::string codec = "";
+        int level = arrow::util::kUseDefaultCompressionLevel;
+        if (jcompression.is_string()) {
+            codec = jcompression.get<std::string>();
+        } else if (jcompression.is_object() &&
+                   jcompression.count("codec") > 0 &&
+                   jcompression.at("codec").is_string()) {
+            codec = jcompression.at("codec").get<std::string>();
+            if (jcompression.count("level") > 0) {
+                if (!jcompression.at("level").is_number_integer()) {
+                    throw parquetwriter::layout_exception(
+                        "Compression \"level\" for field \"" + field_path +
+                        "\" must be an integer");
+                }
+                level = jcompression.at("level").get<int>();
+            }
+        } else {
+            throw parquetwriter::layout_exception(
+                "Invalid \"compression\" for field \"" + field_path +
+                "\", expected a codec name or an object with a "
+                "\"codec\" (and optional \"level\")");
+        }
+        out[field_path] = {codec, level};
+    }
+    return out;
+}
+
+std::map<std::string, std::pair<std::string, int>> column_encoding_from_json(
+    const json& jlayout) {
+    // the encoding name (empty if not given) and whether dictionary
+    // encoding is enabled (-1 if not given)
+    std::map<std::string, std::pair<std::string, int>> out;
+    for (const auto& [field_path, jencoding] :
+         field_option_from_json(jlayout, "encoding")) {
+        if (!jencoding.is_string()) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"encoding\" for field \"" + field_path +
+                "\", expected an encoding name");
+        }
+        out[field_path] = {jencoding.get<std::string>(), -1};
+    }
+    for (const auto& [field_path, jdictionary] :
+         field_option_from_json(jlayout, "dictionary")) {
+        if (!jdictionary.is_boolean()) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"dictionary\" for field \"" + field_path +
+                "\", expected true or false");
+        }
+        if (out.count(field_path) == 0) out[field_path] = {"", -1};
+        out.at(field_path).second = jdictionary.get<bool>() ? 1 : 0;
+    }
+    return out;
+}
+
+std::map<std::string, bool> column_statistics_from_json(const json& jlayout) {
+    std::map<std::string, bool> out;
+    for (const auto& [field_path, jstatistics] :
+         field_option_from_json(jlayout, "statistics")) {
+        if (!jstatistics.is_boolean()) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"statistics\" for field \"" + field_path +
+                "\", expected true or false");
+        }
+        out[field_path] = jstatistics.get<bool>();
+    }
+    return out;
+}
+
+std::map<std::string, std::pair<int64_t, double>>
+column_bloom_filter_from_json(const json& jlayout) {
+    // the expected number of distinct values (0 if not given) and the
+    // false positive probability of the bloom filter of each field
+    std::map<std::string, std::pair<int64_t, double>> out;
+    for (const auto& [field_path, jbloom] :
+         field_option_from_json(jlayout, "bloom_filter")) {
+        // either just true (or false), or an object with the "ndv" and "fpp"
+        if (jbloom.is_boolean()) {
+            if (jbloom.get<bool>()) out[field_path] = {0, 0.05};
+            continue;
+        }
+        if (!jbloom.is_object()) {
+            throw parquetwriter::layout_exception(
+                "Invalid \"bloom_filter\" for field \"" + field_path +
+                "\", expected true or an object with (optional) \"ndv\" and "
+                "\"fpp\"");
+        }
+        int64_t ndv = 0;
+        double fpp = 0.05;
+        if (jbloom.count("ndv") > 0) {
+            if (!jbloom.at("ndv").is_number_integer() ||
+                jbloom.at("ndv").get<int64_t>() <= 0) {
+                throw parquetwriter::layout_exception(
+                    "Bloom filter \"ndv\" for field \"" + field_path +
+                    "\" must be a positive integer");
+            }
+            ndv = jbloom.at("ndv").get<int64_t>();
+        }
+        if (jbloom.count("fpp") > 0) {
+            if (!jbloom.at("fpp").is_number() ||
+                jbloom.at("fpp").get<double>() <= 0.0 ||
+                jbloom.at("fpp").get<double>() >= 1.0) {
+                throw parquetwriter::layout_exception(
+                    "Bloom filter \"fpp\" for field \"" + field_path +
+                    "\" must be a probability between 0 and 1 (exclusive)");
+            }
+            fpp = jbloom.at("fpp").get<double>();
+        }
+        out[field_path] = {ndv, fpp};
+    }
+    return out;
+}
+
+parquet::Encoding::type parquet_encoding_from_string(
+    const std::string& encoding) {
+    // the dictionary encodings are chosen with "dictionary", not here
+    static const std::map<std::string, parquet::Encoding::type> encodings = {
+        {"PLAIN", parquet::Encoding::PLAIN},
+        {"RLE", parquet::Encoding::RLE},
+        {"DELTA_BINARY_PACKED", parquet::Encoding::DELTA_BINARY_PACKED},
+        {"DELTA_LENGTH_BYTE_ARRAY",
+         parquet::Encoding::DELTA_LENGTH_BYTE_ARRAY},
+        {"DELTA_BYTE_ARRAY", parquet::Encoding::DELTA_BYTE_ARRAY},
+        {"BYTE_STREAM_SPLIT", parquet::Encoding::BYTE_STREAM_SPLIT}};
+    std::string name = encoding;
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    if (encodings.count(name) == 0) {
+        throw parquetwriter::layout_exception("Unsupported encoding \"" +
+                                              encoding + "\"");
+    }
+    return encodings.at(name);
+}
+
+std::string leaf_field_path(const parquet::ColumnDescriptor* column) {
+    // the path of the leaf column in terms of the layout's fields, i.e.
+    // without the repeated group and element nodes that encode lists
+    auto is_list = [](const parquet::schema::Node* node) {
+        return node && node->logical_type() &&
+               node->logical_type()->is_list();
+    };
+    std::vector<std::string> names;
+    for (const parquet::schema::Node* node = column->schema_node().get();
+         node && node->parent(); node = node->parent()) {
+        const auto* parent = node->parent();
+        if (is_list(parent) || (parent && is_list(parent->parent()))) {
+            continue;
+        }
+        names.push_back(node->name());
+    }
+
+    std::string path = "";
+    for (auto name = names.rbegin(); name != names.rend(); name++) {
+        path += (path.empty() ? "" : ".") + *name;
+    }
+    return path;
+}
+
+std::shared_ptr<arrow::Buffer> encoded_column(
+    const std::shared_ptr<arrow::Field>& field,
+    const std::shared_ptr<arrow::Array>& array,
+    const std::shared_ptr<parquet::WriterProperties>& properties,
+    const std::shared_ptr<parquet::ArrowWriterProperties>& arrow_properties) {
+    auto table = arrow::Table::Make(arrow::schema({field}), {array});
+    std::shared_ptr<arrow::io::BufferOutputStream> sink;
+    PARQUET_ASSIGN_OR_THROW(sink, arrow::io::BufferOutputStream::Create());
+    PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(
+        *table, arrow::default_memory_pool(), sink, array->length(),
+        properties, arrow_properties));
+    std::shared_ptr<arrow::Buffer> buffer;
+    PARQUET_ASSIGN_OR_THROW(buffer, sink->Finish());
+    return buffer;
+}
+
+std::pair<double, double> trial_compress(const arrow::Buffer& buffer,
+                                         arrow::Compression::type compression,
+                                         int level) {
+    // returns the compression ratio and throughput (in MB/s of input)
+    std::unique_ptr<arrow::util::Codec> codec;
+    PARQUET_ASSIGN_OR_THROW(codec,
+                            arrow::util::Codec::Create(compression, level));
+    int64_t max_length = codec->MaxCompressedLen(buffer.size(), buffer.data());
+    std::vector<uint8_t> compressed(max_length);
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t compressed_length = 0;
+    PARQUET_ASSIGN_OR_THROW(
+        compressed_length,
+        codec->Compress(buffer.size(), buffer.data(), max_length,
+                        compressed.data()));
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    double ratio = static_cast<double>(buffer.size()) /
+                   std::max<int64_t>(compressed_length, 1);
+    double throughput =
+        buffer.size() / (1024.0 * 1024.0) / std::max(seconds, 1e-9);
+    return {ratio, throughput};
+}
+
+uint16_t float_to_half(float value) {
+    // IEEE 754 binary32 to binary16, rounding to nearest even like F16C
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+    if (magnitude >= 0x7f800000) {
+        // infinity, or nan (kept quiet)
+        return sign | 0x7c00 |
+               (magnitude > 0x7f800000 ? 0x200 | ((magnitude >> 13) & 0x3ff)
+                                       : 0);
+    }
+    if (magnitude >= 0x477ff000) {
+        // rounds past the largest half (65504)
+        return sign | 0x7c00;
+    }
+    if (magnitude < 0x38800000) {
+        // below the smallest normal half (2^-14), rounds to a subnormal
+        if (magnitude < 0x33000000) return sign;
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        int shift = 126 - static_cast<int>(magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+    // re-bias the exponent, a carry out of the mantissa rounds it up
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t remainder = magnitude & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+#ifdef PARQUETWRITER_X86_DISPATCH
+namespace internal {
+bool cpu_has_f16c() {
+    static const bool has_f16c = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0 &&
+               __builtin_cpu_supports("f16c") != 0;
+    }();
+    return has_f16c;
+}
+
+// convert the leading multiple of 8 of the n_values, 8 values at a time
+// with the F16C conversion instructions, returns the number converted
+__attribute__((target("avx,f16c"))) int64_t floats_to_halves_f16c(
+    const float* values, uint16_t* halves, int64_t n_values) {
+    int64_t i = 0;
+    for (; i + 8 <= n_values; i += 8) {
+        __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(values + i),
+                                         _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i), packed);
+    }
+    return i;
+}
+};  // namespace internal
+#endif
+
+void floats_to_halves(const float* values, uint16_t* halves,
+                      int64_t n_values) {
+    int64_t i = 0;
+#ifdef PARQUETWRITER_X86_DISPATCH
+    if (internal::cpu_has_f16c()) {
+        i = internal::floats_to_halves_f16c(values, halves, n_values);
+    }
+#endif
+    for (; i < n_values; i++) {
+        halves[i] = float_to_half(values[i]);
+    }
+}
+
+namespace internal {
+// the type with half-precision floats replaced by the uint16 holding their
+// bits, where the parquet library cannot write them as such
+std::shared_ptr<arrow::DataType> storage_type(
+    const std::shared_ptr<arrow::DataType>& type) {
+#ifdef PARQUETWRITER_HAVE_FLOAT16
+    return type;
+#else
+    if (type->id() == arrow::Type::HALF_FLOAT) {
+        return arrow::uint16();
+    }
+    if (type->num_fields() == 0) {
+        return type;
+    }
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    bool changed = false;
+    for (const auto& field : type->fields()) {
+        auto field_type = storage_type(field->type());
+        changed = changed || field_type != field->type();
+        fields.push_back(field->WithType(field_type));
+    }
+    if (!changed) {
+        return type;
+    }
+    switch (type->id()) {
+        case arrow::Type::LIST:
+            return arrow::list(fields.at(0));
+        case arrow::Type::LARGE_LIST:
+            return arrow::large_list(fields.at(0));
+        case arrow::Type::FIXED_SIZE_LIST:
+            return arrow::fixed_size_list(
+                fields.at(0),
+                static_cast<const arrow::FixedSizeListType&>(*type)
+                    .list_size());
+        case arrow::Type::MAP: {
+            const auto& entries = fields.at(0)->type();
+            return arrow::map(entries->field(0)->type(),
+                              entries->field(1)->type());
+        }
+        default:
+            return arrow::struct_(fields);
+    }
+#endif
+}
+};  // namespace internal
+
+std::shared_ptr<arrow::Field> storage_field(
+    const std::shared_ptr<arrow::Field>& field) {
+    auto type = internal::storage_type(field->type());
+    if (type == field->type()) {
+        return field;
+    }
+    // flag the columns holding the bits of half-precision floats
+    return field->WithType(type)->WithMergedMetadata(
+        arrow::key_value_metadata({"parquetwriter.float16"}, {"uint16"}));
+}
+
+std::shared_ptr<arrow::ArrayData> storage_array_data(
+    const std::shared_ptr<arrow::ArrayData>& data) {
+    auto type = internal::storage_type(data->type);
+    if (type == data->type) {
+        return data;
+    }
+    // the same buffers, viewed as the storage type
+    auto storage_data = std::make_shared<arrow::ArrayData>(*data);
+    storage_data->type = type;
+    for (auto& child : storage_data->child_data) {
+        child = storage_array_data(child);
+    }
+    return storage_data;
+}
+
 };  // namespace helpers
 };  // namespace parquetwriter
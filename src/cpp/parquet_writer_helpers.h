@@ -13,7 +13,9 @@
 #include <arrow/api.h>
 #include <arrow/io/api.h>
 #include <arrow/type.h>  // struct_
+#include <parquet/arrow/writer.h>
 #include <parquet/exception.h>
+#include <parquet/schema.h>
 
 // json
 #include "nlohmann/json.hpp"
@@ -36,7 +38,12 @@ struct ArrowTypeInit {
     type_ptr get_uint64() { return arrow::uint64(); }
     type_ptr get_float32() { return arrow::float32(); }
     type_ptr get_float64() { return arrow::float64(); }
+    type_ptr get_float16() { return arrow::float16(); }
     type_ptr get_string() { return arrow::utf8(); }
+    type_ptr get_binary() { return arrow::binary(); }
+    type_ptr get_large_string() { return arrow::large_utf8(); }
+    type_ptr get_large_binary() { return arrow::large_binary(); }
+    type_ptr get_date32() { return arrow::date32(); }
 
 };  // ArrowTypeInit
 
@@ -54,7 +61,14 @@ static std::map<std::string, TypeInitFunc> const type_init_map = {
     {"uint64", &parquetwriter::helpers::internal::ArrowTypeInit::get_uint64},
     {"float", &parquetwriter::helpers::internal::ArrowTypeInit::get_float32},
     {"double", &parquetwriter::helpers::internal::ArrowTypeInit::get_float64},
-    {"string", &parquetwriter::helpers::internal::ArrowTypeInit::get_string}};
+    {"float16", &parquetwriter::helpers::internal::ArrowTypeInit::get_float16},
+    {"string", &parquetwriter::helpers::internal::ArrowTypeInit::get_string},
+    {"binary", &parquetwriter::helpers::internal::ArrowTypeInit::get_binary},
+    {"large_string",
+     &parquetwriter::helpers::internal::ArrowTypeInit::get_large_string},
+    {"large_binary",
+     &parquetwriter::helpers::internal::ArrowTypeInit::get_large_binary},
+    {"date32", &parquetwriter::helpers::internal::ArrowTypeInit::get_date32}};
 
 };  // namespace internal
 
@@ -62,6 +76,10 @@ using nlohmann::json;
 
 std::shared_ptr<arrow::DataType> datatype_from_string(
     const std::string& type_string);
+std::shared_ptr<arrow::DataType> parameterized_datatype_from_string(
+    const std::string& type_string);
+arrow::Type::type fill_type_id(arrow::Type::type type_id);
+bool has_nanosecond_timestamps(const std::shared_ptr<arrow::DataType>& type);
 std::vector<std::shared_ptr<arrow::Field>> columns_from_json(
     const json& jlayout, const std::string& current_node = "");
 
@@ -69,9 +87,73 @@ void check_layout_list(const nlohmann::json& layout,
                        const std::string& column_name);
 void check_layout_struct(const nlohmann::json& layout,
                          const std::string& column_name);
+void check_layout_dictionary(const nlohmann::json& layout,
+                             const std::string& column_name);
+std::vector<int32_t> check_layout_fixed_list(const nlohmann::json& layout,
+                                             const std::string& column_name);
+std::pair<std::shared_ptr<arrow::DataType>, std::shared_ptr<arrow::DataType>>
+check_layout_map(const nlohmann::json& layout, const std::string& column_name);
 
 std::string parent_column_name_from_field(const std::string& field_path);
 
+std::vector<std::string> value_columns_from_json(
+    const json& jlayout, const std::string& option,
+    const std::string& description,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns);
+std::vector<std::string> partition_columns_from_json(
+    const json& jlayout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns);
+std::vector<std::string> sort_columns_from_json(
+    const json& jlayout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns);
+std::string hive_partition_value(const std::string& value);
+
+std::map<std::string, json> field_option_from_json(
+    const json& jlayout, const std::string& option,
+    const std::string& current_node = "");
+std::map<std::string, std::pair<std::string, int>> column_compression_from_json(
+    const json& jlayout);
+std::map<std::string, std::pair<std::string, int>> column_encoding_from_json(
+    const json& jlayout);
+std::map<std::string, bool> column_statistics_from_json(const json& jlayout);
+std::map<std::string, std::pair<int64_t, double>>
+column_bloom_filter_from_json(const json& jlayout);
+parquet::Encoding::type parquet_encoding_from_string(
+    const std::string& encoding);
+std::string leaf_field_path(const parquet::ColumnDescriptor* column);
+
+std::shared_ptr<arrow::Buffer> encoded_column(
+    const std::shared_ptr<arrow::Field>& field,
+    const std::shared_ptr<arrow::Array>& array,
+    const std::shared_ptr<parquet::WriterProperties>& properties,
+    const std::shared_ptr<parquet::ArrowWriterProperties>& arrow_properties);
+std::pair<double, double> trial_compress(const arrow::Buffer& buffer,
+                                         arrow::Compression::type compression,
+                                         int level);
+
+std::vector<std::vector<std::string>> check_shard_layout(
+    const std::vector<std::vector<std::string>>& shard_layout,
+    const std::vector<std::shared_ptr<arrow::Field>>& columns);
+std::vector<std::vector<std::string>> balance_columns(
+    const std::vector<std::shared_ptr<arrow::Field>>& columns,
+    uint32_t n_shards);
+double estimated_value_size(const std::shared_ptr<arrow::DataType>& type);
+int64_t array_data_size(const std::shared_ptr<arrow::ArrayData>& data);
+
+void truncate_mantissa(uint8_t* float_values, int64_t n_values, int keep_bits);
+void truncate_mantissa_double(uint8_t* double_values, int64_t n_values,
+                              int keep_bits);
+void truncate_mantissas(const std::shared_ptr<arrow::ArrayData>& data,
+                        const std::string& field_path,
+                        const std::map<std::string, int>& keep_mantissa_bits);
+
+uint16_t float_to_half(float value);
+void floats_to_halves(const float* values, uint16_t* halves, int64_t n_values);
+std::shared_ptr<arrow::Field> storage_field(
+    const std::shared_ptr<arrow::Field>& field);
+std::shared_ptr<arrow::ArrayData> storage_array_data(
+    const std::shared_ptr<arrow::ArrayData>& data);
+
 std::pair<std::vector<std::string>,
           std::map<std::string, std::map<std::string, arrow::ArrayBuilder*>>>
 fill_field_builder_map_from_columns(
@@ -86,7 +168,12 @@ std::vector<std::string> struct_field_order_from_builder(
     arrow::ArrayBuilder* builder, const std::string& field_path);
 bool builder_is_struct_type(arrow::ArrayBuilder* builder);
 std::pair<unsigned, arrow::ArrayBuilder*> list_builder_description(
-    arrow::ListBuilder* list_builder);
+    arrow::ArrayBuilder* list_builder);
+bool is_list_type(arrow::Type::type type_id);
+arrow::ArrayBuilder* list_value_builder(arrow::ArrayBuilder* list_builder);
+arrow::Status list_builder_append(arrow::ArrayBuilder* list_builder);
+bool has_int32_offsets(const std::shared_ptr<arrow::DataType>& type);
+int64_t max_int32_offset(arrow::ArrayBuilder* builder);
 std::pair<std::vector<std::string>, std::vector<arrow::ArrayBuilder*>>
 struct_type_field_builders(arrow::ArrayBuilder* builder,
                            const std::string& column_name);
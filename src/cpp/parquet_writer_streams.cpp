@@ -0,0 +1,470 @@
+#include "parquet_writer_streams.h"
+
+#include "parquet_writer_exceptions.h"
+
+// std/stl
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+// arrow
+#include <arrow/buffer.h>
+#include <arrow/io/buffered.h>
+#include <arrow/io/file.h>
+
+// posix
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef PARQUETWRITER_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace parquetwriter {
+namespace streams {
+
+CountingOutputStream::CountingOutputStream(
+    std::shared_ptr<arrow::io::OutputStream> raw)
+    : _raw(std::move(raw)), _n_writes(0), _n_bytes(0) {}
+
+arrow::Status CountingOutputStream::Close() { return _raw->Close(); }
+
+arrow::Status CountingOutputStream::Abort() { return _raw->Abort(); }
+
+bool CountingOutputStream::closed() const { return _raw->closed(); }
+
+arrow::Result<int64_t> CountingOutputStream::Tell() const {
+    return static_cast<int64_t>(_n_bytes);
+}
+
+arrow::Status CountingOutputStream::Flush() { return _raw->Flush(); }
+
+arrow::Status CountingOutputStream::Write(const void* data, int64_t nbytes) {
+    _n_writes++;
+    _n_bytes += nbytes;
+    return _raw->Write(data, nbytes);
+}
+
+arrow::Status CountingOutputStream::Write(
+    const std::shared_ptr<arrow::Buffer>& data) {
+    _n_writes++;
+    _n_bytes += data->size();
+    return _raw->Write(data);
+}
+
+#ifdef PARQUETWRITER_HAVE_LIBURING
+
+namespace {
+// the offset and size alignment required by O_DIRECT on most devices
+constexpr int64_t DIRECT_ALIGNMENT = 4096;
+
+int64_t align_up(int64_t n) {
+    return (n + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+}
+
+arrow::Status errno_status(const std::string& what, int error) {
+    return arrow::Status::IOError(what + ": " + std::strerror(error));
+}
+};  // namespace
+
+struct UringOutputStream::Impl {
+    int fd = -1;
+    bool direct = false;
+    bool closed = true;
+    bool ring_initialized = false;
+    struct io_uring ring;
+
+    // the aligned buffers, those not currently in flight, the one being
+    // filled and how much of it is filled
+    int64_t buffer_size = 0;
+    std::vector<void*> buffers;
+    std::deque<size_t> free_buffers;
+    size_t current = 0;
+    int64_t fill = 0;
+
+    // the file offset of the start of the buffer being filled, how much of
+    // it was written out by the last Flush(), and the number of writes in
+    // flight (with the size and offset of each, by buffer)
+    int64_t file_offset = 0;
+    int64_t flushed = 0;
+    uint32_t n_in_flight = 0;
+    std::vector<int64_t> expected;
+    std::vector<int64_t> offsets;
+    std::vector<bool> in_flight;
+
+    ~Impl() {
+        if (ring_initialized) io_uring_queue_exit(&ring);
+        if (fd >= 0) ::close(fd);
+        for (auto buffer : buffers) std::free(buffer);
+    }
+
+    arrow::Status submit(size_t ibuffer, int64_t nbytes, int64_t offset) {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            return arrow::Status::IOError("io_uring submission queue is full");
+        }
+        io_uring_prep_write(sqe, fd, buffers.at(ibuffer), nbytes, offset);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(ibuffer));
+        expected.at(ibuffer) = nbytes;
+        offsets.at(ibuffer) = offset;
+        int ret = io_uring_submit(&ring);
+        if (ret < 0) return errno_status("io_uring_submit failed", -ret);
+        n_in_flight++;
+        in_flight.at(ibuffer) = true;
+        return arrow::Status::OK();
+    }
+
+    arrow::Status reap_one() {
+        struct io_uring_cqe* cqe = nullptr;
+        int ret = io_uring_wait_cqe(&ring, &cqe);
+        if (ret < 0) return errno_status("io_uring_wait_cqe failed", -ret);
+        size_t ibuffer = reinterpret_cast<size_t>(io_uring_cqe_get_data(cqe));
+        int res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        n_in_flight--;
+        in_flight.at(ibuffer) = false;
+        free_buffers.push_back(ibuffer);
+        if (res < 0) return errno_status("io_uring write failed", -res);
+        if (res != expected.at(ibuffer)) {
+            return arrow::Status::IOError("io_uring short write (" +
+                                          std::to_string(res) + " of " +
+                                          std::to_string(expected.at(ibuffer)) +
+                                          " bytes)");
+        }
+        return arrow::Status::OK();
+    }
+
+    arrow::Status drain() {
+        while (n_in_flight > 0) {
+            ARROW_RETURN_NOT_OK(reap_one());
+        }
+        return arrow::Status::OK();
+    }
+
+    // the writes complete out of order, so only the bytes before the first
+    // write still in flight are known to be in the file
+    int64_t completed_offset() const {
+        int64_t completed = file_offset + flushed;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (in_flight.at(i)) completed = std::min(completed, offsets.at(i));
+        }
+        return completed;
+    }
+
+    arrow::Status next_buffer() {
+        while (free_buffers.empty()) {
+            ARROW_RETURN_NOT_OK(reap_one());
+        }
+        current = free_buffers.front();
+        free_buffers.pop_front();
+        fill = 0;
+        return arrow::Status::OK();
+    }
+};
+
+bool UringOutputStream::available() {
+    static const bool is_available = []() {
+        // kernels without probing (before 5.6) have no IORING_OP_WRITE
+        // either, and io_uring may be disabled altogether
+        struct io_uring_probe* probe = io_uring_get_probe();
+        if (!probe) return false;
+        bool supported = io_uring_opcode_supported(probe, IORING_OP_WRITE);
+        io_uring_free_probe(probe);
+        return supported;
+    }();
+    return is_available;
+}
+
+arrow::Result<std::shared_ptr<UringOutputStream>> UringOutputStream::Open(
+    const std::string& path, int64_t buffer_size, uint32_t queue_depth) {
+    std::shared_ptr<UringOutputStream> stream(new UringOutputStream());
+    auto& impl = *stream->_impl;
+
+    // not all filesystems (e.g. tmpfs) support O_DIRECT
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    impl.fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    impl.direct = impl.fd >= 0;
+    if (impl.fd < 0 && errno == EINVAL) {
+        impl.fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (impl.fd < 0) {
+        return errno_status("Failed to open \"" + path + "\"", errno);
+    }
+
+    int ret = io_uring_queue_init(queue_depth, &impl.ring, 0);
+    if (ret < 0) return errno_status("io_uring_queue_init failed", -ret);
+    impl.ring_initialized = true;
+
+    impl.buffer_size = align_up(std::max<int64_t>(buffer_size, 1));
+    for (uint32_t i = 0; i < queue_depth; i++) {
+        void* buffer = nullptr;
+        if (posix_memalign(&buffer, DIRECT_ALIGNMENT, impl.buffer_size) != 0) {
+            return arrow::Status::OutOfMemory(
+                "Failed to allocate io_uring output buffer");
+        }
+        impl.buffers.push_back(buffer);
+        impl.free_buffers.push_back(i);
+    }
+    impl.expected.resize(queue_depth, 0);
+    impl.offsets.resize(queue_depth, 0);
+    impl.in_flight.resize(queue_depth, false);
+    ARROW_RETURN_NOT_OK(impl.next_buffer());
+    impl.closed = false;
+    return stream;
+}
+
+arrow::Status UringOutputStream::Write(const void* data, int64_t nbytes) {
+    auto& impl = *_impl;
+    if (impl.closed) return arrow::Status::Invalid("Operation on closed stream");
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (nbytes > 0) {
+        int64_t n = std::min(nbytes, impl.buffer_size - impl.fill);
+        std::memcpy(static_cast<uint8_t*>(impl.buffers.at(impl.current)) +
+                        impl.fill,
+                    bytes, n);
+        impl.fill += n;
+        bytes += n;
+        nbytes -= n;
+
+        // hand the full buffer over and carry on filling a free one
+        if (impl.fill == impl.buffer_size) {
+            ARROW_RETURN_NOT_OK(
+                impl.submit(impl.current, impl.buffer_size, impl.file_offset));
+            impl.file_offset += impl.buffer_size;
+            impl.flushed = 0;
+            ARROW_RETURN_NOT_OK(impl.next_buffer());
+        }
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status UringOutputStream::Flush() {
+    auto& impl = *_impl;
+    if (impl.closed) return arrow::Status::Invalid("Operation on closed stream");
+    ARROW_RETURN_NOT_OK(impl.drain());
+    if (impl.fill == 0) return arrow::Status::OK();
+
+    // the partial buffer is written padded out to the alignment, and is
+    // written again (over the padding) once it has been filled further
+    int64_t nbytes = align_up(impl.fill);
+    uint8_t* buffer = static_cast<uint8_t*>(impl.buffers.at(impl.current));
+    std::memset(buffer + impl.fill, 0, nbytes - impl.fill);
+    ssize_t written = ::pwrite(impl.fd, buffer, nbytes, impl.file_offset);
+    if (written < 0) {
+        return errno_status("Failed to write to output file", errno);
+    }
+    if (written != nbytes) {
+        return arrow::Status::IOError("Short write to output file (" +
+                                      std::to_string(written) + " of " +
+                                      std::to_string(nbytes) + " bytes)");
+    }
+    impl.flushed = impl.fill;
+    return arrow::Status::OK();
+}
+
+arrow::Status UringOutputStream::Close() {
+    auto& impl = *_impl;
+    if (impl.closed) return arrow::Status::OK();
+    ARROW_RETURN_NOT_OK(this->Flush());
+    impl.closed = true;
+
+    // trim the padding of the final block
+    if (::ftruncate(impl.fd, impl.file_offset + impl.fill) != 0) {
+        return errno_status("Failed to truncate output file", errno);
+    }
+    int fd = impl.fd;
+    impl.fd = -1;
+    if (::close(fd) != 0) {
+        return errno_status("Failed to close output file", errno);
+    }
+    return arrow::Status::OK();
+}
+
+arrow::Status UringOutputStream::Abort() {
+    auto& impl = *_impl;
+    if (impl.closed) return arrow::Status::OK();
+    impl.closed = true;
+    auto status = impl.drain();
+    ::close(impl.fd);
+    impl.fd = -1;
+    return status;
+}
+
+bool UringOutputStream::closed() const { return _impl->closed; }
+
+arrow::Result<int64_t> UringOutputStream::Tell() const {
+    return _impl->file_offset + _impl->fill;
+}
+
+int UringOutputStream::file_descriptor() const { return _impl->fd; }
+
+bool UringOutputStream::direct() const { return _impl->direct; }
+
+int64_t UringOutputStream::completed_bytes() const {
+    return _impl->completed_offset();
+}
+
+#else
+
+// without liburing the stream can never be opened
+struct UringOutputStream::Impl {};
+
+bool UringOutputStream::available() { return false; }
+
+arrow::Result<std::shared_ptr<UringOutputStream>> UringOutputStream::Open(
+    const std::string&, int64_t, uint32_t) {
+    return arrow::Status::NotImplemented(
+        "parquet-writer was built without liburing");
+}
+
+arrow::Status UringOutputStream::Write(const void*, int64_t) {
+    return arrow::Status::NotImplemented("io_uring output stream");
+}
+
+arrow::Status UringOutputStream::Flush() { return arrow::Status::OK(); }
+
+arrow::Status UringOutputStream::Close() { return arrow::Status::OK(); }
+
+arrow::Status UringOutputStream::Abort() { return arrow::Status::OK(); }
+
+bool UringOutputStream::closed() const { return true; }
+
+arrow::Result<int64_t> UringOutputStream::Tell() const { return 0; }
+
+int UringOutputStream::file_descriptor() const { return -1; }
+
+bool UringOutputStream::direct() const { return false; }
+
+int64_t UringOutputStream::completed_bytes() const { return 0; }
+
+#endif
+
+UringOutputStream::UringOutputStream() : _impl(std::make_unique<Impl>()) {}
+
+UringOutputStream::~UringOutputStream() {
+    // the destructor of arrow::io::OutputStream does not close the stream,
+    // and errors cannot be reported from here
+    if (!this->closed()) {
+        (void)this->Close();
+    }
+}
+
+CallbackOutputStream::CallbackOutputStream(Callback callback)
+    : _callback(std::move(callback)), _position(0), _closed(false) {}
+
+arrow::Status CallbackOutputStream::Close() {
+    _closed = true;
+    return arrow::Status::OK();
+}
+
+bool CallbackOutputStream::closed() const { return _closed; }
+
+arrow::Result<int64_t> CallbackOutputStream::Tell() const { return _position; }
+
+arrow::Status CallbackOutputStream::Write(const void* data, int64_t nbytes) {
+    if (_closed) return arrow::Status::Invalid("Operation on closed stream");
+    try {
+        _callback(static_cast<const uint8_t*>(data), nbytes);
+    } catch (std::exception& e) {
+        return arrow::Status::IOError("Output callback failed: " +
+                                      std::string(e.what()));
+    }
+    _position += nbytes;
+    return arrow::Status::OK();
+}
+
+namespace {
+// the descriptor if it refers to a regular file, -1 otherwise (e.g. for
+// pipes, which cannot be synced or have their pages released)
+int regular_file_descriptor(int fd) {
+    struct stat file_stat;
+    if (fd < 0 || ::fstat(fd, &file_stat) != 0 ||
+        !S_ISREG(file_stat.st_mode)) {
+        return -1;
+    }
+    return fd;
+}
+};  // namespace
+
+int file_descriptor(const std::shared_ptr<arrow::io::OutputStream>& stream) {
+    if (!stream) return -1;
+    if (auto file = std::dynamic_pointer_cast<arrow::io::FileOutputStream>(
+            stream)) {
+        return regular_file_descriptor(file->file_descriptor());
+    } else if (auto uring =
+                   std::dynamic_pointer_cast<UringOutputStream>(stream)) {
+        return regular_file_descriptor(uring->file_descriptor());
+    } else if (auto counting =
+                   std::dynamic_pointer_cast<CountingOutputStream>(stream)) {
+        return file_descriptor(counting->raw());
+    } else if (auto buffered =
+                   std::dynamic_pointer_cast<arrow::io::BufferedOutputStream>(
+                       stream)) {
+        return file_descriptor(buffered->raw());
+    }
+    return -1;
+}
+
+void fsync(int fd) {
+    if (::fsync(fd) != 0) {
+        throw parquetwriter::writer_exception(
+            "Failed to fsync output file: " + std::string(std::strerror(errno)));
+    }
+}
+
+bool preallocate(int fd, int64_t nbytes) {
+    if (nbytes <= 0) return true;
+#ifdef __linux__
+    return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, nbytes) == 0;
+#else
+    return false;
+#endif
+}
+
+void truncate(int fd, int64_t nbytes) {
+    if (::ftruncate(fd, nbytes) != 0) {
+        throw parquetwriter::writer_exception(
+            "Failed to truncate output file: " +
+            std::string(std::strerror(errno)));
+    }
+}
+
+void start_writeback(int fd, int64_t offset, int64_t nbytes) {
+    if (nbytes <= 0) return;
+#ifdef __linux__
+    if (::sync_file_range(fd, offset, nbytes, SYNC_FILE_RANGE_WRITE) != 0) {
+        throw parquetwriter::writer_exception(
+            "Failed to start writeback of output file: " +
+            std::string(std::strerror(errno)));
+    }
+#endif
+}
+
+void release_range(int fd, int64_t offset, int64_t nbytes) {
+    if (nbytes <= 0) return;
+#ifdef __linux__
+    // the pages must be clean for the kernel to drop them
+    if (::sync_file_range(fd, offset, nbytes,
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                              SYNC_FILE_RANGE_WAIT_AFTER) != 0) {
+        throw parquetwriter::writer_exception(
+            "Failed to write back output file: " +
+            std::string(std::strerror(errno)));
+    }
+    // only advice, so failures are not errors
+    ::posix_fadvise(fd, offset, nbytes, POSIX_FADV_DONTNEED);
+#else
+    // no page cache control elsewhere
+    (void)fd;
+    (void)offset;
+#endif
+}
+
+};  // namespace streams
+};  // namespace parquetwriter
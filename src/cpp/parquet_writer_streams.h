@@ -0,0 +1,129 @@
+#ifndef PARQUETWRITER_STREAMS_H
+#define PARQUETWRITER_STREAMS_H
+
+// std/stl
+#include <functional>
+#include <memory>
+#include <string>
+
+// arrow
+#include <arrow/io/interfaces.h>
+
+namespace parquetwriter {
+namespace streams {
+
+// pass-through OutputStream that keeps count of the write calls (and bytes)
+// that reach the wrapped stream, i.e. the number of write syscalls issued
+// when the wrapped stream is a file; the position is tracked from the bytes
+// written, so that the wrapped stream need not be seekable (e.g. a pipe)
+class CountingOutputStream : public arrow::io::OutputStream {
+ public:
+    explicit CountingOutputStream(std::shared_ptr<arrow::io::OutputStream> raw);
+
+    arrow::Status Close() override;
+    arrow::Status Abort() override;
+    bool closed() const override;
+    arrow::Result<int64_t> Tell() const override;
+    arrow::Status Flush() override;
+
+    using arrow::io::OutputStream::Write;
+    arrow::Status Write(const void* data, int64_t nbytes) override;
+    arrow::Status Write(const std::shared_ptr<arrow::Buffer>& data) override;
+
+    const std::shared_ptr<arrow::io::OutputStream>& raw() const { return _raw; }
+    uint64_t n_writes() const { return _n_writes; }
+    uint64_t n_bytes() const { return _n_bytes; }
+
+ private:
+    std::shared_ptr<arrow::io::OutputStream> _raw;
+    uint64_t _n_writes;
+    uint64_t _n_bytes;
+};  // class CountingOutputStream
+
+// OutputStream handing each write over to a callback as a chunk of bytes
+class CallbackOutputStream : public arrow::io::OutputStream {
+ public:
+    typedef std::function<void(const uint8_t*, int64_t)> Callback;
+
+    explicit CallbackOutputStream(Callback callback);
+
+    arrow::Status Close() override;
+    bool closed() const override;
+    arrow::Result<int64_t> Tell() const override;
+
+    using arrow::io::OutputStream::Write;
+    arrow::Status Write(const void* data, int64_t nbytes) override;
+
+ private:
+    Callback _callback;
+    int64_t _position;
+    bool _closed;
+};  // class CallbackOutputStream
+
+// OutputStream writing to a local file through io_uring, keeping several
+// (aligned) buffers in flight and opening the file with O_DIRECT where the
+// filesystem supports it, so that the output bypasses the page cache; only
+// functional when built against liburing
+class UringOutputStream : public arrow::io::OutputStream {
+ public:
+    // whether io_uring can be used on this system
+    static bool available();
+
+    // open the file at the given (local) path with queue_depth buffers of
+    // (at least) buffer_size bytes each
+    static arrow::Result<std::shared_ptr<UringOutputStream>> Open(
+        const std::string& path, int64_t buffer_size, uint32_t queue_depth);
+    ~UringOutputStream() override;
+
+    arrow::Status Close() override;
+    arrow::Status Abort() override;
+    bool closed() const override;
+    arrow::Result<int64_t> Tell() const override;
+
+    // waits for the writes in flight and writes out the partially filled
+    // buffer (which stays in memory, to be completed by later writes)
+    arrow::Status Flush() override;
+
+    using arrow::io::OutputStream::Write;
+    arrow::Status Write(const void* data, int64_t nbytes) override;
+
+    int file_descriptor() const;
+    bool direct() const;
+
+    // the number of bytes at the start of the file whose writes have
+    // completed (the rest are queued in, or being written from, the buffers)
+    int64_t completed_bytes() const;
+
+ private:
+    UringOutputStream();
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};  // class UringOutputStream
+
+// returns the file descriptor backing the provided stream, or -1 if the
+// stream is not backed by a local, regular file
+int file_descriptor(const std::shared_ptr<arrow::io::OutputStream>& stream);
+
+// fsync the provided file descriptor, throws on failure
+void fsync(int fd);
+
+// reserve disk space for the first nbytes of the file without changing its
+// size, returns false if the filesystem does not support it
+bool preallocate(int fd, int64_t nbytes);
+
+// truncate the file to the given size (also releasing any space reserved
+// beyond it), throws on failure
+void truncate(int fd, int64_t nbytes);
+
+// start the writeback of the given byte range of the file to disk without
+// waiting for it, throws on failure
+void start_writeback(int fd, int64_t offset, int64_t nbytes);
+
+// wait for the writeback of the given byte range of the file and drop it
+// from the page cache, throws on failure (a no-op outside of Linux)
+void release_range(int fd, int64_t offset, int64_t nbytes);
+
+};  // namespace streams
+};  // namespace parquetwriter
+
+#endif
@@ -4,6 +4,8 @@
 #include <stdint.h>
 
 #include <map>
+#include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -22,6 +24,7 @@ typedef std::variant<
     int64_t,
     float,
     double,
+    std::string,
     std::vector<bool>,
     std::vector<uint8_t>,
     std::vector<uint16_t>,
@@ -33,6 +36,7 @@ typedef std::variant<
     std::vector<int64_t>,
     std::vector<float>,
     std::vector<double>,
+    std::vector<std::string>,
     std::vector<std::vector<bool>>,
     std::vector<std::vector<uint8_t>>,
     std::vector<std::vector<uint16_t>>,
@@ -44,6 +48,7 @@ typedef std::variant<
     std::vector<std::vector<int64_t>>,
     std::vector<std::vector<float>>,
     std::vector<std::vector<double>>,
+    std::vector<std::vector<std::string>>,
     std::vector<std::vector<std::vector<bool>>>,
     std::vector<std::vector<std::vector<uint8_t>>>,
     std::vector<std::vector<std::vector<uint16_t>>>,
@@ -54,13 +59,23 @@ typedef std::variant<
     std::vector<std::vector<std::vector<int32_t>>>,
     std::vector<std::vector<std::vector<int64_t>>>,
     std::vector<std::vector<std::vector<float>>>,
-    std::vector<std::vector<std::vector<double>>>>
+    std::vector<std::vector<std::vector<double>>>,
+    std::vector<std::vector<std::vector<std::string>>>>
     buffer_value_t;
 // clang-format on
 };  // namespace types
 
 // these are the only types we should have
 typedef types::buffer_value_t value_t;
+
+// whether a string literal (const char*) converts to the std::string
+// alternative of value_t: it converts to the bool alternative instead with
+// a std::variant predating P0608 (e.g. libstdc++ before GCC 10), in which
+// case the strings in field_buffer_t and field_map_t must be given as
+// std::string
+inline constexpr bool literals_are_strings =
+    std::variant<bool, std::string_view>("").index() == 1;
+
 typedef std::vector<value_t> field_buffer_t;
 typedef std::map<std::string, value_t> field_map_t;
 
@@ -4,21 +4,29 @@
 #include "parquet_writer_exceptions.h"
 #include "parquet_writer_helpers.h"
 
+// std/stl
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <variant>
+
 #define THROW_FOR_INVALID_TYPE(FIELDNAME, ARROWTYPE, ARRAYBUILDER, LISTDEPTH)  \
-    if (ARRAYBUILDER->type()->id() != arrow::Type::ARROWTYPE) {                \
-        if (ARRAYBUILDER->type()->id() == arrow::Type::LIST ||                 \
+    if (helpers::fill_type_id(ARRAYBUILDER->type()->id()) !=                   \
+        arrow::Type::ARROWTYPE) {                                              \
+        if (helpers::is_list_type(ARRAYBUILDER->type()->id()) ||               \
             LISTDEPTH > 0) {                                                   \
             arrow::ArrayBuilder* expected_builder = nullptr;                   \
             unsigned depth = 0;                                                \
-            if (ARRAYBUILDER->type()->id() == arrow::Type::LIST) {             \
-                auto list_builder =                                            \
-                    dynamic_cast<arrow::ListBuilder*>(ARRAYBUILDER);           \
+            if (helpers::is_list_type(ARRAYBUILDER->type()->id())) {           \
                 std::tie(depth, expected_builder) =                            \
-                    helpers::list_builder_description(list_builder);           \
+                    helpers::list_builder_description(ARRAYBUILDER);           \
             } else {                                                           \
                 expected_builder = ARRAYBUILDER;                               \
             }                                                                  \
-            if (expected_builder->type()->id() != arrow::Type::ARROWTYPE ||    \
+            if (helpers::fill_type_id(expected_builder->type()->id()) !=       \
+                    arrow::Type::ARROWTYPE ||                                  \
                 depth != LISTDEPTH) {                                          \
                 std::string expect_type =                                      \
                     (depth > 0 ? "list" + std::to_string(depth) + "d[" +       \
@@ -41,48 +49,47 @@
         }                                                                      \
     }
 
-#define VALUE_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                    \
-    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(ARRAYBUILDER); \
+#define VALUE_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                          \
+    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(ARRAYBUILDER);       \
     PARQUET_THROW_NOT_OK(value_builder->Append(val));
 
-// macro for filling 1d lists (vector<...>)
-#define LIST1D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                   \
-    auto list_builder = dynamic_cast<arrow::ListBuilder*>(ARRAYBUILDER); \
-    auto value_builder =                                                 \
-        dynamic_cast<VALUEBUILDERCLASS*>(list_builder->value_builder()); \
-    PARQUET_THROW_NOT_OK(list_builder->Append());                        \
+// macro for filling 1d lists (vector<...>), the list builders being
+// either list or large_list builders
+#define LIST1D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                        \
+    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(                    \
+        helpers::list_value_builder(ARRAYBUILDER));                           \
+    PARQUET_THROW_NOT_OK(helpers::list_builder_append(ARRAYBUILDER));         \
     PARQUET_THROW_NOT_OK(value_builder->AppendValues(val));
 
 // macro for filling 2d lists (vector<vector<...>>)
-#define LIST2D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                    \
-    auto list_builder = dynamic_cast<arrow::ListBuilder*>(ARRAYBUILDER);  \
-    PARQUET_THROW_NOT_OK(list_builder->Append());                         \
-    list_builder =                                                        \
-        dynamic_cast<arrow::ListBuilder*>(list_builder->value_builder()); \
-    auto value_builder =                                                  \
-        dynamic_cast<VALUEBUILDERCLASS*>(list_builder->value_builder());  \
-    for (size_t i = 0; i < val.size(); i++) {                             \
-        PARQUET_THROW_NOT_OK(list_builder->Append());                     \
-        PARQUET_THROW_NOT_OK(value_builder->AppendValues(val.at(i)));     \
+#define LIST2D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                        \
+    auto inner_list_builder = helpers::list_value_builder(ARRAYBUILDER);      \
+    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(                    \
+        helpers::list_value_builder(inner_list_builder));                     \
+    PARQUET_THROW_NOT_OK(helpers::list_builder_append(ARRAYBUILDER));         \
+    for (size_t i = 0; i < val.size(); i++) {                                 \
+        PARQUET_THROW_NOT_OK(                                                 \
+            helpers::list_builder_append(inner_list_builder));                \
+        PARQUET_THROW_NOT_OK(value_builder->AppendValues(val.at(i)));         \
     }
 
 // macro for filling 3d lists (vector<vector<vector<...>>>)
-#define LIST3D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                    \
-    auto list_builder = dynamic_cast<arrow::ListBuilder*>(ARRAYBUILDER);  \
-    auto inner_list_builder =                                             \
-        dynamic_cast<arrow::ListBuilder*>(list_builder->value_builder()); \
-    auto inner_inner_list_builder = dynamic_cast<arrow::ListBuilder*>(    \
-        inner_list_builder->value_builder());                             \
-    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(                \
-        inner_inner_list_builder->value_builder());                       \
-    PARQUET_THROW_NOT_OK(list_builder->Append());                         \
-    for (size_t i = 0; i < val.size(); i++) {                             \
-        PARQUET_THROW_NOT_OK(inner_list_builder->Append());               \
-        for (size_t j = 0; j < val.at(i).size(); j++) {                   \
-            PARQUET_THROW_NOT_OK(inner_inner_list_builder->Append());     \
-            PARQUET_THROW_NOT_OK(                                         \
-                value_builder->AppendValues(val.at(i).at(j)));            \
-        }                                                                 \
+#define LIST3D_APPEND(ARRAYBUILDER, VALUEBUILDERCLASS)                        \
+    auto inner_list_builder = helpers::list_value_builder(ARRAYBUILDER);      \
+    auto inner_inner_list_builder =                                           \
+        helpers::list_value_builder(inner_list_builder);                      \
+    auto value_builder = dynamic_cast<VALUEBUILDERCLASS*>(                    \
+        helpers::list_value_builder(inner_inner_list_builder));               \
+    PARQUET_THROW_NOT_OK(helpers::list_builder_append(ARRAYBUILDER));         \
+    for (size_t i = 0; i < val.size(); i++) {                                 \
+        PARQUET_THROW_NOT_OK(                                                 \
+            helpers::list_builder_append(inner_list_builder));                \
+        for (size_t j = 0; j < val.at(i).size(); j++) {                       \
+            PARQUET_THROW_NOT_OK(                                             \
+                helpers::list_builder_append(inner_inner_list_builder));      \
+            PARQUET_THROW_NOT_OK(                                             \
+                value_builder->AppendValues(val.at(i).at(j)));                \
+        }                                                                     \
     }
 
 namespace parquetwriter {
@@ -91,6 +98,439 @@ namespace internal {
 template <class>
 inline constexpr bool missing_type_impl_for = false;
 
+// check that the builder (or the value builder of the list builder, at the
+// given depth) holds strings or binary values (possibly dictionary-encoded)
+inline void throw_for_invalid_binary_type(const std::string& field_name,
+                                          arrow::ArrayBuilder* builder,
+                                          unsigned list_depth) {
+    arrow::ArrayBuilder* value_builder = builder;
+    unsigned depth = 0;
+    if (helpers::is_list_type(builder->type()->id())) {
+        std::tie(depth, value_builder) =
+            helpers::list_builder_description(builder);
+    }
+    auto id = value_builder->type()->id();
+    bool is_binary = id == arrow::Type::STRING || id == arrow::Type::BINARY ||
+                     id == arrow::Type::LARGE_STRING ||
+                     id == arrow::Type::LARGE_BINARY ||
+                     id == arrow::Type::DICTIONARY;
+    if (!is_binary || depth != list_depth) {
+        std::string expect_type =
+            (depth > 0 ? "list" + std::to_string(depth) + "d[" +
+                             value_builder->type()->name() + "]"
+                       : builder->type()->name());
+        std::string got_type =
+            (list_depth > 0 ? "list" + std::to_string(list_depth) + "d[string]"
+                            : "string");
+        throw parquetwriter::data_type_exception(
+            "Invalid data type provided for column/field \"" + field_name +
+            "\", expect: \"" + expect_type + "\", got: \"" + got_type + "\"");
+    }
+}
+
+// call function with the builder cast to its (string or binary) type
+template <typename Function>
+void visit_binary_builder(arrow::ArrayBuilder* builder, Function&& function) {
+    switch (builder->type()->id()) {
+        case arrow::Type::STRING: {
+            function(static_cast<arrow::StringBuilder*>(builder));
+            break;
+        }
+        case arrow::Type::BINARY: {
+            function(static_cast<arrow::BinaryBuilder*>(builder));
+            break;
+        }
+        case arrow::Type::LARGE_STRING: {
+            function(static_cast<arrow::LargeStringBuilder*>(builder));
+            break;
+        }
+        case arrow::Type::LARGE_BINARY: {
+            function(static_cast<arrow::LargeBinaryBuilder*>(builder));
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// call function with the builder of dictionary-encoded strings or binary
+// values cast to its type (always created with int32 indices)
+template <typename Function>
+void visit_dictionary_builder(arrow::ArrayBuilder* builder,
+                              Function&& function) {
+    const auto& dictionary_type =
+        static_cast<const arrow::DictionaryType&>(*builder->type());
+    switch (dictionary_type.value_type()->id()) {
+        case arrow::Type::STRING: {
+            function(static_cast<arrow::StringDictionary32Builder*>(builder));
+            break;
+        }
+        case arrow::Type::BINARY: {
+            function(static_cast<arrow::BinaryDictionary32Builder*>(builder));
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+// check that n_bytes more bytes fit in the data buffer of the builder,
+// which is limited to 2 GB for the (non-large) string and binary types
+template <typename BinaryBuilderType>
+void check_binary_capacity(const std::string& field_name,
+                           const BinaryBuilderType* builder, int64_t n_bytes) {
+    if (builder->value_data_length() + n_bytes > builder->memory_limit()) {
+        throw parquetwriter::data_buffer_exception(
+            "Column/field \"" + field_name + "\" holds more string data than " +
+            "its type \"" + builder->type()->name() + "\" allows in a " +
+            "RowGroup, use a smaller RowGroup size or a large_string (or " +
+            "large_binary) type");
+    }
+}
+
+// append the string to the builder, straight into its data buffer (or, for
+// dictionary-encoded values, as the index of its entry in the dictionary)
+template <typename String>
+void binary_append(const std::string& field_name, arrow::ArrayBuilder* builder,
+                   const String& val) {
+    if (builder->type()->id() == arrow::Type::DICTIONARY) {
+        visit_dictionary_builder(builder, [&](auto* value_builder) {
+            PARQUET_THROW_NOT_OK(value_builder->Append(
+                val.data(), static_cast<int32_t>(val.size())));
+        });
+        return;
+    }
+    visit_binary_builder(builder, [&](auto* value_builder) {
+        check_binary_capacity(field_name, value_builder, val.size());
+        PARQUET_THROW_NOT_OK(value_builder->Append(val.data(), val.size()));
+    });
+}
+
+// append the strings to the builder, straight into its data buffer
+template <typename Strings>
+void binary_append_values(const std::string& field_name,
+                          arrow::ArrayBuilder* builder, const Strings& val) {
+    int64_t n_bytes = 0;
+    for (const auto& value : val) {
+        n_bytes += value.size();
+    }
+    visit_binary_builder(builder, [&](auto* value_builder) {
+        check_binary_capacity(field_name, value_builder, n_bytes);
+        PARQUET_THROW_NOT_OK(value_builder->Reserve(val.size()));
+        PARQUET_THROW_NOT_OK(value_builder->ReserveData(n_bytes));
+        for (const auto& value : val) {
+            value_builder->UnsafeAppend(value.data(), value.size());
+        }
+    });
+}
+
+// whether the values of the builder (or of the value builder of the list
+// builder) are of a logical type filled with values of another type, e.g.
+// timestamps (int64 ticks) or half-precision floats (floats)
+inline bool is_logical_fill_type(arrow::ArrayBuilder* builder) {
+    arrow::ArrayBuilder* value_builder = builder;
+    if (helpers::is_list_type(builder->type()->id())) {
+        value_builder = helpers::list_builder_description(builder).second;
+    }
+    auto id = value_builder->type()->id();
+    return helpers::fill_type_id(id) != id;
+}
+
+// append the n int64 (or int32) values straight into the builder of the
+// timestamps, durations, or decimals (or dates) that they are the ticks,
+// unscaled values (or days) of
+template <typename Int>
+void integer_append_values(const std::string& field_name,
+                           arrow::ArrayBuilder* builder, const Int* values,
+                           int64_t n) {
+    if constexpr (std::is_same_v<Int, int32_t>) {
+        PARQUET_THROW_NOT_OK(
+            static_cast<arrow::Date32Builder*>(builder)->AppendValues(values,
+                                                                      n));
+    } else {
+        switch (builder->type()->id()) {
+            case arrow::Type::TIMESTAMP: {
+                PARQUET_THROW_NOT_OK(
+                    static_cast<arrow::TimestampBuilder*>(builder)
+                        ->AppendValues(values, n));
+                break;
+            }
+            case arrow::Type::DURATION: {
+                PARQUET_THROW_NOT_OK(
+                    static_cast<arrow::DurationBuilder*>(builder)->AppendValues(
+                        values, n));
+                break;
+            }
+            case arrow::Type::DECIMAL128: {
+                auto decimal_builder =
+                    static_cast<arrow::Decimal128Builder*>(builder);
+                int32_t precision =
+                    static_cast<const arrow::Decimal128Type&>(*builder->type())
+                        .precision();
+                int64_t limit = std::numeric_limits<int64_t>::max();
+                if (precision < 19) {
+                    limit = 1;
+                    for (int32_t i = 0; i < precision; i++) limit *= 10;
+                }
+                PARQUET_THROW_NOT_OK(decimal_builder->Reserve(n));
+                for (int64_t i = 0; i < n; i++) {
+                    if (values[i] >= limit || values[i] <= -limit) {
+                        throw parquetwriter::data_type_exception(
+                            "Unscaled value " + std::to_string(values[i]) +
+                            " provided for column/field \"" + field_name +
+                            "\" does not fit in its type \"" +
+                            builder->type()->ToString() + "\"");
+                    }
+                    PARQUET_THROW_NOT_OK(
+                        decimal_builder->Append(arrow::Decimal128(values[i])));
+                }
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+}
+
+// append the n floats to the builder of half-precision floats, converted
+// a chunk at a time (with F16C instructions where available)
+inline void float16_append_values(arrow::ArrayBuilder* builder,
+                                  const float* values, int64_t n) {
+    auto half_float_builder = static_cast<arrow::HalfFloatBuilder*>(builder);
+    PARQUET_THROW_NOT_OK(half_float_builder->Reserve(n));
+    constexpr int64_t chunk_size = 256;
+    uint16_t halves[chunk_size];
+    for (int64_t i = 0; i < n; i += chunk_size) {
+        int64_t n_chunk = std::min(chunk_size, n - i);
+        helpers::floats_to_halves(values + i, halves, n_chunk);
+        PARQUET_THROW_NOT_OK(half_float_builder->AppendValues(halves, n_chunk));
+    }
+}
+
+// append the n values to the builder of the logical type that they fill
+template <typename T>
+void logical_append_values(const std::string& field_name,
+                           arrow::ArrayBuilder* builder, const T* values,
+                           int64_t n) {
+    if constexpr (std::is_same_v<T, float>) {
+        float16_append_values(builder, values, n);
+    } else if constexpr (std::is_same_v<T, int32_t> ||
+                         std::is_same_v<T, int64_t>) {
+        integer_append_values(field_name, builder, values, n);
+    }
+}
+
+// append the value (or the nested vectors of them) to the builder (or list
+// builder) of the logical type that they fill
+template <typename Value>
+void logical_append(const std::string& field_name, arrow::ArrayBuilder* builder,
+                    const Value& val) {
+    if constexpr (std::is_arithmetic_v<Value>) {
+        logical_append_values(field_name, builder, &val, 1);
+    } else {
+        PARQUET_THROW_NOT_OK(helpers::list_builder_append(builder));
+        auto value_builder = helpers::list_value_builder(builder);
+        if constexpr (std::is_arithmetic_v<typename Value::value_type>) {
+            logical_append_values(field_name, value_builder, val.data(),
+                                  val.size());
+        } else {
+            for (const auto& inner : val) {
+                logical_append(field_name, value_builder, inner);
+            }
+        }
+    }
+}
+
+// append the n values straight into the value builder, converting them to
+// the logical type of the column where it differs from their type
+template <typename T>
+void append_values(const std::string& field_name, arrow::ArrayBuilder* builder,
+                   const T* values, int64_t n) {
+    auto id = builder->type()->id();
+    if (helpers::fill_type_id(id) != id) {
+        logical_append_values(field_name, builder, values, n);
+    } else {
+        using BuilderType = typename arrow::TypeTraits<
+            typename arrow::CTypeTraits<T>::ArrowType>::BuilderType;
+        PARQUET_THROW_NOT_OK(
+            static_cast<BuilderType*>(builder)->AppendValues(values, n));
+    }
+}
+
+// append the n values, of the numeric type with the given id, straight from
+// memory into the value builder
+inline void append_typed_values(const std::string& field_name,
+                                arrow::ArrayBuilder* builder,
+                                const void* values, arrow::Type::type type_id,
+                                int64_t n) {
+    switch (type_id) {
+        case arrow::Type::UINT8:
+            append_values(field_name, builder,
+                          static_cast<const uint8_t*>(values), n);
+            break;
+        case arrow::Type::UINT16:
+            append_values(field_name, builder,
+                          static_cast<const uint16_t*>(values), n);
+            break;
+        case arrow::Type::UINT32:
+            append_values(field_name, builder,
+                          static_cast<const uint32_t*>(values), n);
+            break;
+        case arrow::Type::UINT64:
+            append_values(field_name, builder,
+                          static_cast<const uint64_t*>(values), n);
+            break;
+        case arrow::Type::INT8:
+            append_values(field_name, builder,
+                          static_cast<const int8_t*>(values), n);
+            break;
+        case arrow::Type::INT16:
+            append_values(field_name, builder,
+                          static_cast<const int16_t*>(values), n);
+            break;
+        case arrow::Type::INT32:
+            append_values(field_name, builder,
+                          static_cast<const int32_t*>(values), n);
+            break;
+        case arrow::Type::INT64:
+            append_values(field_name, builder,
+                          static_cast<const int64_t*>(values), n);
+            break;
+        case arrow::Type::FLOAT:
+            append_values(field_name, builder,
+                          static_cast<const float*>(values), n);
+            break;
+        case arrow::Type::DOUBLE:
+            append_values(field_name, builder,
+                          static_cast<const double*>(values), n);
+            break;
+        default:
+            throw parquetwriter::data_type_exception(
+                "Invalid data type provided for column/field \"" +
+                field_name + "\", expect: \"" + builder->type()->ToString() +
+                "\", got: values of a non-numeric type");
+    }
+}
+
+// append the n values (in row-major order) to the (possibly nested)
+// fixed-size list builder as one entry, straight into its value builder
+template <typename T>
+void fixed_list_append(const std::string& field_name,
+                       arrow::ArrayBuilder* builder, const T* values,
+                       size_t n) {
+    using ArrowType = typename arrow::CTypeTraits<T>::ArrowType;
+    std::vector<arrow::FixedSizeListBuilder*> list_builders;
+    std::vector<int64_t> n_entries;
+    arrow::ArrayBuilder* value_builder = builder;
+    int64_t n_values = 1;
+    while (value_builder->type()->id() == arrow::Type::FIXED_SIZE_LIST) {
+        auto list_builder =
+            static_cast<arrow::FixedSizeListBuilder*>(value_builder);
+        list_builders.push_back(list_builder);
+        n_entries.push_back(n_values);
+        n_values *= static_cast<const arrow::FixedSizeListType&>(
+                        *list_builder->type())
+                        .list_size();
+        value_builder = list_builder->value_builder();
+    }
+    if (list_builders.empty() ||
+        helpers::fill_type_id(value_builder->type()->id()) !=
+            ArrowType::type_id) {
+        throw parquetwriter::data_type_exception(
+            "Invalid data type provided for column/field \"" + field_name +
+            "\", expect: \"" + builder->type()->ToString() +
+            "\", got: \"fixed_list[" +
+            arrow::TypeTraits<ArrowType>::type_singleton()->name() + "]\"");
+    }
+    if (static_cast<int64_t>(n) != n_values) {
+        throw parquetwriter::data_type_exception(
+            "Invalid number of values provided for fixed_list column/field \"" +
+            field_name + "\", expect: " + std::to_string(n_values) +
+            ", got: " + std::to_string(n));
+    }
+
+    // one entry of the outermost list is as many entries of the inner ones
+    // as the outer dimensions hold, and no offsets are kept at any level
+    for (size_t ilist = 0; ilist < list_builders.size(); ilist++) {
+        PARQUET_THROW_NOT_OK(
+            list_builders.at(ilist)->AppendValues(n_entries.at(ilist)));
+    }
+    append_values(field_name, value_builder, values, n_values);
+}
+
+// append the n values to the list builder as one entry (of a 1d list),
+// straight into its value builder
+template <typename T>
+void list_append(const std::string& field_name, arrow::ArrayBuilder* builder,
+                 const T* values, size_t n) {
+    using ArrowType = typename arrow::CTypeTraits<T>::ArrowType;
+    auto value_builder = helpers::is_list_type(builder->type()->id())
+                             ? helpers::list_value_builder(builder)
+                             : nullptr;
+    if (!value_builder || helpers::fill_type_id(value_builder->type()->id()) !=
+                              ArrowType::type_id) {
+        throw parquetwriter::data_type_exception(
+            "Invalid data type provided for column/field \"" + field_name +
+            "\", expect: \"" + builder->type()->ToString() +
+            "\", got: \"list1d[" +
+            arrow::TypeTraits<ArrowType>::type_singleton()->name() + "]\"");
+    }
+    PARQUET_THROW_NOT_OK(helpers::list_builder_append(builder));
+    append_values(field_name, value_builder, values, n);
+}
+
+template <typename>
+inline constexpr bool is_numeric_vector = false;
+
+template <typename T>
+inline constexpr bool is_numeric_vector<std::vector<T>> =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+template <typename>
+inline constexpr bool is_variant = false;
+
+template <typename... Ts>
+inline constexpr bool is_variant<std::variant<Ts...>> = true;
+
+// an upper bound on how far appending the value moves the 32-bit offsets of
+// the builders that it goes into: the number of elements of each level of
+// the lists (or structs) plus the number of bytes of the strings
+template <typename Value>
+int64_t offset_growth(const Value& val);
+
+template <typename K, typename V>
+int64_t offset_growth(const std::map<K, V>& val) {
+    int64_t growth = 0;
+    for (const auto& [key, inner] : val) {
+        growth += offset_growth(inner);
+    }
+    return growth;
+}
+
+template <typename Value>
+int64_t offset_growth(const Value& val) {
+    if constexpr (std::is_arithmetic_v<Value>) {
+        return 0;
+    } else if constexpr (std::is_same_v<Value, std::string> ||
+                         std::is_same_v<Value, std::string_view>) {
+        return static_cast<int64_t>(val.size());
+    } else if constexpr (is_variant<Value>) {
+        return std::visit(
+            [](const auto& inner) { return offset_growth(inner); }, val);
+    } else {
+        int64_t growth = static_cast<int64_t>(val.size());
+        if constexpr (!std::is_arithmetic_v<typename Value::value_type>) {
+            for (const auto& inner : val) {
+                growth += offset_growth(inner);
+            }
+        }
+        return growth;
+    }
+}
+
 struct DataValueFillVisitor {
     DataValueFillVisitor(const std::string& field_name,
                          arrow::ArrayBuilder* builder)
@@ -101,6 +541,21 @@ struct DataValueFillVisitor {
     template <class type>
     void operator()(const type& val) {
         using T = std::decay_t<decltype(val)>;
+        if (_builder->type()->id() == arrow::Type::FIXED_SIZE_LIST) {
+            // fixed-size lists are filled with the flat vector of their values
+            if constexpr (is_numeric_vector<T>) {
+                fixed_list_append(_field_name, _builder, val.data(),
+                                  val.size());
+            } else {
+                throw parquetwriter::data_type_exception(
+                    "Invalid data type provided for column/field \"" +
+                    _field_name + "\", expect: \"" +
+                    _builder->type()->ToString() +
+                    "\" filled with a flat std::vector of its values");
+            }
+            return;
+        }
+
         if constexpr (std::is_same_v<T, bool>) {
             THROW_FOR_INVALID_TYPE(_field_name, BOOL, _builder, 0)
             VALUE_APPEND(_builder, arrow::BooleanBuilder)
@@ -124,16 +579,31 @@ struct DataValueFillVisitor {
             VALUE_APPEND(_builder, arrow::Int16Builder)
         } else if constexpr (std::is_same_v<T, int32_t>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT32, _builder, 0)
-            VALUE_APPEND(_builder, arrow::Int32Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                VALUE_APPEND(_builder, arrow::Int32Builder)
+            }
         } else if constexpr (std::is_same_v<T, int64_t>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT64, _builder, 0)
-            VALUE_APPEND(_builder, arrow::Int64Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                VALUE_APPEND(_builder, arrow::Int64Builder)
+            }
         } else if constexpr (std::is_same_v<T, float>) {
             THROW_FOR_INVALID_TYPE(_field_name, FLOAT, _builder, 0)
-            VALUE_APPEND(_builder, arrow::FloatBuilder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                VALUE_APPEND(_builder, arrow::FloatBuilder)
+            }
         } else if constexpr (std::is_same_v<T, double>) {
             THROW_FOR_INVALID_TYPE(_field_name, DOUBLE, _builder, 0)
             VALUE_APPEND(_builder, arrow::DoubleBuilder)
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            throw_for_invalid_binary_type(_field_name, _builder, 0);
+            binary_append(_field_name, _builder, val);
         } else if constexpr (std::is_same_v<T, std::vector<bool>>) {
             THROW_FOR_INVALID_TYPE(_field_name, BOOL, _builder, 1)
             LIST1D_APPEND(_builder, arrow::BooleanBuilder)
@@ -157,16 +627,33 @@ struct DataValueFillVisitor {
             LIST1D_APPEND(_builder, arrow::Int16Builder)
         } else if constexpr (std::is_same_v<T, std::vector<int32_t>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT32, _builder, 1)
-            LIST1D_APPEND(_builder, arrow::Int32Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST1D_APPEND(_builder, arrow::Int32Builder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<int64_t>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT64, _builder, 1)
-            LIST1D_APPEND(_builder, arrow::Int64Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST1D_APPEND(_builder, arrow::Int64Builder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<float>>) {
             THROW_FOR_INVALID_TYPE(_field_name, FLOAT, _builder, 1)
-            LIST1D_APPEND(_builder, arrow::FloatBuilder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST1D_APPEND(_builder, arrow::FloatBuilder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<double>>) {
             THROW_FOR_INVALID_TYPE(_field_name, DOUBLE, _builder, 1)
             LIST1D_APPEND(_builder, arrow::DoubleBuilder)
+        } else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+            throw_for_invalid_binary_type(_field_name, _builder, 1);
+            PARQUET_THROW_NOT_OK(helpers::list_builder_append(_builder));
+            binary_append_values(_field_name,
+                                 helpers::list_value_builder(_builder), val);
         } else if constexpr (std::is_same_v<T,
                                             std::vector<std::vector<bool>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, BOOL, _builder, 2)
@@ -198,19 +685,43 @@ struct DataValueFillVisitor {
         } else if constexpr (std::is_same_v<
                                  T, std::vector<std::vector<int32_t>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT32, _builder, 2)
-            LIST2D_APPEND(_builder, arrow::Int32Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST2D_APPEND(_builder, arrow::Int32Builder)
+            }
         } else if constexpr (std::is_same_v<
                                  T, std::vector<std::vector<int64_t>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT64, _builder, 2)
-            LIST2D_APPEND(_builder, arrow::Int64Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST2D_APPEND(_builder, arrow::Int64Builder)
+            }
         } else if constexpr (std::is_same_v<T,
                                             std::vector<std::vector<float>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, FLOAT, _builder, 2)
-            LIST2D_APPEND(_builder, arrow::FloatBuilder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST2D_APPEND(_builder, arrow::FloatBuilder)
+            }
         } else if constexpr (std::is_same_v<T,
                                             std::vector<std::vector<double>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, DOUBLE, _builder, 2)
             LIST2D_APPEND(_builder, arrow::DoubleBuilder)
+        } else if constexpr (std::is_same_v<
+                                 T, std::vector<std::vector<std::string>>>) {
+            throw_for_invalid_binary_type(_field_name, _builder, 2);
+            PARQUET_THROW_NOT_OK(helpers::list_builder_append(_builder));
+            auto inner_list_builder = helpers::list_value_builder(_builder);
+            for (const auto& inner : val) {
+                PARQUET_THROW_NOT_OK(
+                    helpers::list_builder_append(inner_list_builder));
+                binary_append_values(
+                    _field_name,
+                    helpers::list_value_builder(inner_list_builder), inner);
+            }
         } else if constexpr (std::is_same_v<
                                  T,
                                  std::vector<std::vector<std::vector<bool>>>>) {
@@ -243,19 +754,50 @@ struct DataValueFillVisitor {
         } else if constexpr (std::is_same_v<T, std::vector<std::vector<
                                                    std::vector<int32_t>>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT32, _builder, 3)
-            LIST3D_APPEND(_builder, arrow::Int32Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST3D_APPEND(_builder, arrow::Int32Builder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<std::vector<
                                                    std::vector<int64_t>>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, INT64, _builder, 3)
-            LIST3D_APPEND(_builder, arrow::Int64Builder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST3D_APPEND(_builder, arrow::Int64Builder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<std::vector<
                                                    std::vector<float>>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, FLOAT, _builder, 3)
-            LIST3D_APPEND(_builder, arrow::FloatBuilder)
+            if (is_logical_fill_type(_builder)) {
+                logical_append(_field_name, _builder, val);
+            } else {
+                LIST3D_APPEND(_builder, arrow::FloatBuilder)
+            }
         } else if constexpr (std::is_same_v<T, std::vector<std::vector<
                                                    std::vector<double>>>>) {
             THROW_FOR_INVALID_TYPE(_field_name, DOUBLE, _builder, 3)
             LIST3D_APPEND(_builder, arrow::DoubleBuilder)
+        } else if constexpr (std::is_same_v<T, std::vector<std::vector<
+                                                   std::vector<std::string>>>>) {
+            throw_for_invalid_binary_type(_field_name, _builder, 3);
+            auto inner_list_builder = helpers::list_value_builder(_builder);
+            auto inner_inner_list_builder =
+                helpers::list_value_builder(inner_list_builder);
+            PARQUET_THROW_NOT_OK(helpers::list_builder_append(_builder));
+            for (const auto& inner : val) {
+                PARQUET_THROW_NOT_OK(
+                    helpers::list_builder_append(inner_list_builder));
+                for (const auto& inner_inner : inner) {
+                    PARQUET_THROW_NOT_OK(
+                        helpers::list_builder_append(inner_inner_list_builder));
+                    binary_append_values(
+                        _field_name,
+                        helpers::list_value_builder(inner_inner_list_builder),
+                        inner_inner);
+                }
+            }
         } else {
             static_assert(missing_type_impl_for<T>,
                           "Data filling visitor is non-exhaustive");
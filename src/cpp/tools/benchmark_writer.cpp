@@ -0,0 +1,270 @@
+#include "parquet_writer.h"
+
+// std/stl
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// json
+#include <nlohmann/json.hpp>
+
+namespace pw = parquetwriter;
+
+//
+// write n_rows rows of a mixed numeric layout with the given I/O backend and
+// report the throughput and output counters
+//
+void run_io_benchmark(const pw::IOBackend& backend, uint64_t n_rows,
+                      const std::string& output_dir) {
+    auto layout = R"(
+        {
+            "fields": [
+                {"name": "event", "type": "uint64"},
+                {"name": "weight", "type": "double"},
+                {"name": "pt", "type": "list1d", "contains": {"type": "float"}},
+                {"name": "eta", "type": "list1d", "contains": {"type": "float"}},
+                {"name": "phi", "type": "list1d", "contains": {"type": "float"}},
+                {"name": "charge", "type": "list1d", "contains": {"type": "int8"}}
+            ]
+        })"_json;
+
+    pw::Writer writer;
+    writer.set_layout(layout);
+    writer.set_dataset_name("benchmark_" + pw::Writer::iobackend2str(backend));
+    writer.set_output_directory(output_dir);
+    writer.set_io_backend(backend);
+    writer.initialize();
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    std::poisson_distribution<int> multiplicity(8);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t irow = 0; irow < n_rows; irow++) {
+        size_t n = multiplicity(generator);
+        std::vector<float> pt(n), eta(n), phi(n);
+        std::vector<int8_t> charge(n);
+        for (size_t i = 0; i < n; i++) {
+            pt.at(i) = 100.0 * uniform(generator);
+            eta.at(i) = 5.0 * uniform(generator) - 2.5;
+            phi.at(i) = 6.3 * uniform(generator) - 3.15;
+            charge.at(i) = uniform(generator) > 0.5 ? 1 : -1;
+        }
+        writer.fill("event", irow);
+        writer.fill("weight", static_cast<double>(uniform(generator)));
+        writer.fill("pt", pt);
+        writer.fill("eta", eta);
+        writer.fill("phi", phi);
+        writer.fill("charge", charge);
+        writer.end_row();
+    }
+    writer.finish();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    auto stats = writer.stats();
+    std::cout << "backend = " << pw::Writer::iobackend2str(writer.io_backend())
+              << ", rows = " << stats.rows_written
+              << ", bytes = " << stats.bytes_written
+              << ", writes = " << stats.n_writes << ", time = " << seconds
+              << " s, throughput = "
+              << stats.bytes_written / seconds / (1024 * 1024) << " MB/s"
+              << std::endl;
+}
+
+//
+// write n_rows rows of time-series-like columns (increasing timestamps,
+// noisy measurements and few distinct sensor ids) to memory with the given
+// per-field options, and report the file size and write throughput (returns
+// the time taken, or a negative time if the options are not supported)
+//
+double run_encoding_benchmark(const std::string& name,
+                            const nlohmann::json& time_options,
+                            const nlohmann::json& value_options,
+                            const nlohmann::json& sensor_options,
+                            uint64_t n_rows) {
+    nlohmann::json jtime = {{"name", "time"}, {"type", "int64"}};
+    nlohmann::json jvalue = {{"name", "value"}, {"type", "double"}};
+    nlohmann::json jsensor = {{"name", "sensor"}, {"type", "int32"}};
+    jtime.update(time_options);
+    jvalue.update(value_options);
+    jsensor.update(sensor_options);
+    nlohmann::json layout = {{"fields", {jtime, jvalue, jsensor}}};
+
+    pw::Writer writer;
+    try {
+        writer.set_layout(layout);
+        writer.set_dataset_name("benchmark_" + name);
+        writer.set_output_to_buffer();
+        writer.initialize();
+    } catch (std::exception& e) {
+        std::cout << "encoding = " << name << ": " << e.what() << std::endl;
+        return -1;
+    }
+
+    // the data is generated up front, so that only the writing is timed
+    std::mt19937 generator(42);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_int_distribution<int> step(1, 10);
+    std::uniform_int_distribution<int32_t> sensor(0, 63);
+    std::vector<int64_t> times(n_rows);
+    std::vector<double> values(n_rows);
+    std::vector<int32_t> sensors(n_rows);
+    int64_t time = 1600000000000;
+    for (uint64_t irow = 0; irow < n_rows; irow++) {
+        time += step(generator);
+        times.at(irow) = time;
+        values.at(irow) = 20.0 + noise(generator);
+        sensors.at(irow) = sensor(generator);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t irow = 0; irow < n_rows; irow++) {
+        writer.fill("time", times[irow]);
+        writer.fill("value", values[irow]);
+        writer.fill("sensor", sensors[irow]);
+        writer.end_row();
+    }
+    auto buffer = writer.finish();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::cout << "encoding = " << name << ", rows = " << n_rows
+              << ", file size = " << buffer->size() << " bytes, time = "
+              << seconds << " s, throughput = " << n_rows / seconds / 1e6
+              << " Mrows/s, bloom filter bytes = "
+              << writer.stats().bloom_filter_bytes << std::endl;
+    return seconds;
+}
+
+//
+// write n_rows rows of a nested (list3d) layout to memory with and without
+// the column statistics, and report the write throughput
+//
+void run_statistics_benchmark(bool statistics, uint64_t n_rows) {
+    auto layout = R"(
+        {
+            "fields": [
+                {"name": "event", "type": "uint64"},
+                {"name": "hits", "type": "list3d", "contains": {"type": "float"}},
+                {"name": "cells", "type": "list2d", "contains": {"type": "int32"}}
+            ]
+        })"_json;
+
+    pw::Writer writer;
+    writer.set_layout(layout);
+    writer.set_dataset_name("benchmark_statistics");
+    writer.set_output_to_buffer();
+    writer.set_statistics(statistics);
+    writer.initialize();
+
+    // a pool of rows is generated up front and cycled through, so that
+    // only the writing is timed
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int32_t> cell(0, 1 << 20);
+    std::poisson_distribution<int> multiplicity(4);
+    constexpr size_t n_pool = 4096;
+    std::vector<std::vector<std::vector<std::vector<float>>>> hits_pool(
+        n_pool);
+    std::vector<std::vector<std::vector<int32_t>>> cells_pool(n_pool);
+    for (size_t ipool = 0; ipool < n_pool; ipool++) {
+        auto& hits = hits_pool.at(ipool);
+        hits.resize(multiplicity(generator));
+        for (auto& layer : hits) {
+            layer.resize(multiplicity(generator));
+            for (auto& module : layer) {
+                module.resize(multiplicity(generator));
+                for (auto& hit : module) {
+                    hit = uniform(generator);
+                }
+            }
+        }
+        auto& cells = cells_pool.at(ipool);
+        cells.resize(multiplicity(generator));
+        for (auto& cluster : cells) {
+            cluster.resize(multiplicity(generator));
+            for (auto& value : cluster) {
+                value = cell(generator);
+            }
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t irow = 0; irow < n_rows; irow++) {
+        writer.fill("event", irow);
+        writer.fill("hits", hits_pool[irow % n_pool]);
+        writer.fill("cells", cells_pool[irow % n_pool]);
+        writer.end_row();
+    }
+    auto buffer = writer.finish();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::cout << "statistics = " << (statistics ? "on" : "off")
+              << ", rows = " << n_rows << ", file size = " << buffer->size()
+              << " bytes, time = " << seconds << " s, throughput = "
+              << n_rows / seconds / 1e6 << " Mrows/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t n_rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::string output_dir = argc > 2 ? argv[2] : "benchmark_output";
+    std::string benchmark = argc > 3 ? argv[3] : "all";
+
+    if (benchmark == "all" || benchmark == "io") {
+        for (const auto& backend :
+             {pw::IOBackend::DEFAULT, pw::IOBackend::URING}) {
+            run_io_benchmark(backend, n_rows, output_dir);
+        }
+    }
+
+    if (benchmark == "all" || benchmark == "encoding") {
+        auto none = nlohmann::json::object();
+        nlohmann::json plain = {{"encoding", "plain"}};
+        run_encoding_benchmark("dictionary", none, none, none, n_rows);
+        run_encoding_benchmark("plain", plain, plain, plain, n_rows);
+        run_encoding_benchmark(
+            "delta_byte_stream_split",
+            {{"encoding", "delta_binary_packed"}},
+            {{"encoding", "byte_stream_split"}},
+            {{"encoding", "delta_binary_packed"}}, n_rows);
+        run_encoding_benchmark(
+            "delta_byte_stream_split_dictionary",
+            {{"encoding", "delta_binary_packed"}},
+            {{"encoding", "byte_stream_split"}}, none, n_rows);
+
+        // compressing the measurements, with and without dropping the
+        // (noise) low mantissa bits
+        nlohmann::json split_zstd = {{"encoding", "byte_stream_split"},
+                                     {"compression", "zstd"}};
+        run_encoding_benchmark("byte_stream_split_zstd", none, split_zstd,
+                               none, n_rows);
+        split_zstd["keep_mantissa_bits"] = 12;
+        run_encoding_benchmark("byte_stream_split_zstd_12_bits", none,
+                               split_zstd, none, n_rows);
+
+        // the cost of a bloom filter on the (high-cardinality) timestamps,
+        // timed against the same write without it
+        nlohmann::json bloom_filter = {
+            {"bloom_filter", {{"ndv", n_rows}, {"fpp", 0.01}}}};
+        double without_bloom = run_encoding_benchmark(
+            "dictionary_no_bloom_filter", none, none, none, n_rows);
+        double with_bloom = run_encoding_benchmark(
+            "dictionary_bloom_filter", bloom_filter, none, none, n_rows);
+        std::cout << "bloom filter: time without = " << without_bloom
+                  << " s, time with = " << with_bloom << " s" << std::endl;
+    }
+
+    if (benchmark == "all" || benchmark == "statistics") {
+        run_statistics_benchmark(true, n_rows);
+        run_statistics_benchmark(false, n_rows);
+    }
+    return 0;
+}